@@ -0,0 +1,139 @@
+/***********************************************************************************************************************
+* @file adaptive_spin.h
+*
+* @brief Self tuning spin phase of an idle worker thread - spin shortly before going to sleep.
+*
+* @details	 A thread which runs out of jobs and sleeps on the condition variable must be woken up by the next
+*	Schedule - a system call for the scheduling thread plus a context switch, easily tens of microseconds, before
+*	the job even starts. If the next job comes within a few microseconds it is cheaper to keep the thread awake
+*	for that long and check the queues in a loop.
+*
+*	Spinning is only worth it if the jobs really come that soon, so the spin time is tuned per thread from the
+*	observed idle periods - the time from running out of jobs until the next job is found, i.e. the gaps between
+*	the jobs as this thread sees them. The idle periods are averaged with an exponential moving average and the
+*	thread spins for twice the average. If the average is above the configured maximum, the jobs come too
+*	seldom - the thread does not spin at all and goes to sleep immediately. As the idle period is measured until
+*	the next job also when the thread slept, the spinning starts again once the jobs come faster.
+*
+*	Inside the spin loop the CPU is told that this is a busy wait (pause on x86, yield on ARM), which saves power
+*	and frees the core for the other hyper thread. The number of pauses between two checks is doubled up to a
+*	limit, so that a spinning thread does not hammer the cache lines of the queues.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_ADAPTIVE_SPIN_H
+#define CTP_ADAPTIVE_SPIN_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace CTP
+{
+	// tells the CPU that the thread is in a busy wait loop
+	inline void CpuRelax()
+	{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+		_mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+		__yield();
+#elif defined(__i386__) || defined(__x86_64__)
+		_mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	class AdaptiveSpin
+	{
+	public:
+		typedef std::chrono::steady_clock Clock;
+
+		explicit AdaptiveSpin(std::chrono::nanoseconds maxSpinTime = std::chrono::nanoseconds(0))
+			: m_maxSpinTime(maxSpinTime)
+			, m_averageIdleTime(maxSpinTime.count() / 2)
+		{
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Spins until hasWork() is true or the spin time since idleSince is over.
+		//
+		// Returns true if hasWork() became true, false if the thread should go to sleep.
+		//-----------------------------------------------------------------------------
+		template <typename HasWork>
+		bool Spin(Clock::time_point idleSince, const HasWork& hasWork) const
+		{
+			const std::chrono::nanoseconds spinTime = GetSpinTime();
+			if (spinTime.count() <= 0)
+			{
+				return false;
+			}
+
+			const Clock::time_point deadline = idleSince + spinTime;
+			uint32_t pauses = 1;
+			do
+			{
+				if (hasWork())
+				{
+					return true;
+				}
+				for (uint32_t i = 0; i < pauses; i++)
+				{
+					CpuRelax();
+				}
+				if (pauses < MAX_PAUSES)
+				{
+					pauses *= 2;
+				}
+			} while (Clock::now() < deadline);
+			return hasWork();
+		}
+
+		// adds the length of one idle period - from running out of jobs until the next job was found
+		void RecordIdleTime(std::chrono::nanoseconds idleTime)
+		{
+			// a long pause counts as twice the maximum only - otherwise after a quiet second the average would need
+			// hundreds of short gaps to come down again. Then an exponential moving average with a weight of 1/8
+			const int64_t sample = std::min<int64_t>(idleTime.count(), 2 * m_maxSpinTime.count());
+			m_averageIdleTime += (sample - m_averageIdleTime) / 8;
+		}
+
+		// twice the average idle time, or 0 if the average is above the maximum spin time
+		std::chrono::nanoseconds GetSpinTime() const
+		{
+			const std::chrono::nanoseconds average(m_averageIdleTime);
+			if (average > m_maxSpinTime)
+			{
+				return std::chrono::nanoseconds(0);
+			}
+			return average * 2 < m_maxSpinTime ? average * 2 : m_maxSpinTime;
+		}
+
+	private:
+		// the maximum number of pauses between two checks for work
+		static const uint32_t MAX_PAUSES = 64;
+
+		std::chrono::nanoseconds m_maxSpinTime;
+
+		// in nanoseconds. Starts at half the maximum - a new thread spins for the maximum time until it has seen
+		// the real gaps between the jobs
+		int64_t m_averageIdleTime;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_ADAPTIVE_SPIN_H
@@ -0,0 +1,118 @@
+/***********************************************************************************************************************
+* @file cache_aligned_array.h
+*
+* @brief Fixed size array which puts every element on its own cache line(s).
+*
+* @details	 Used for data which is written by one thread per element - e.g. the partial results of a parallel
+*	reduction. If two such elements share a cache line, every write of one thread invalidates the line in the
+*	cache of the other thread (false sharing) and the parallel code becomes slower than the serial one.
+*
+*	The memory is allocated once, the first element starts at a cache line boundary and each element occupies
+*	a whole number of cache lines. The manual alignment is needed because C++11 does not guarantee that
+*	new honours an alignment bigger than the one of std::max_align_t.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_CACHE_ALIGNED_ARRAY_H
+#define CTP_CACHE_ALIGNED_ARRAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace CTP
+{
+	template <typename T>
+	class CacheAlignedArray
+	{
+	public:
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		// creates count copies of value
+		CacheAlignedArray(size_t count, const T& value)
+			: m_memory(::operator new(count * SLOT_SIZE + CACHE_LINE_SIZE))
+			, m_slots(AlignToCacheLine(m_memory))
+			, m_count(0)
+		{
+			static_assert(std::alignment_of<T>::value <= CACHE_LINE_SIZE, "over-aligned elements are not supported");
+
+			try
+			{
+				for (; m_count < count; m_count++)
+				{
+					new (Slot(m_count)) T(value);
+				}
+			}
+			catch (...)
+			{
+				Destroy();
+				throw;
+			}
+		}
+
+		~CacheAlignedArray()
+		{
+			Destroy();
+		}
+
+		CacheAlignedArray(const CacheAlignedArray&) = delete;
+		CacheAlignedArray& operator=(const CacheAlignedArray&) = delete;
+
+		T& operator[](size_t index)
+		{
+			return *static_cast<T*>(Slot(index));
+		}
+
+		const T& operator[](size_t index) const
+		{
+			return *static_cast<const T*>(Slot(index));
+		}
+
+		size_t Size() const
+		{
+			return m_count;
+		}
+
+	private:
+		// each element takes a whole number of cache lines
+		static const size_t SLOT_SIZE = (sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+
+		static char* AlignToCacheLine(void* memory)
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+			return reinterpret_cast<char*>((address + CACHE_LINE_SIZE - 1) & ~(uintptr_t(CACHE_LINE_SIZE) - 1));
+		}
+
+		void* Slot(size_t index) const
+		{
+			return m_slots + index * SLOT_SIZE;
+		}
+
+		void Destroy()
+		{
+			while (m_count > 0)
+			{
+				m_count--;
+				(*this)[m_count].~T();
+			}
+			::operator delete(m_memory);
+			m_memory = nullptr;
+		}
+
+		void* m_memory;
+		char* m_slots;
+		size_t m_count;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_CACHE_ALIGNED_ARRAY_H
@@ -0,0 +1,189 @@
+/***********************************************************************************************************************
+* @file cpu_affinity.cpp
+*
+* @brief Pinning of the threads of the Thread Pool to CPUs - the implementation.
+*
+* @details	 See cpu_affinity.h. Only Linux is supported - elsewhere no CPU is known and nothing is pinned.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "cpu_affinity.h"
+#include "cpu_topology.h"
+
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace CTP
+{
+	AffinityPolicy AffinityPolicy::Compact()
+	{
+		AffinityPolicy policy;
+		policy.mode = AffinityMode::Compact;
+		return policy;
+	}
+
+	AffinityPolicy AffinityPolicy::Scatter()
+	{
+		AffinityPolicy policy;
+		policy.mode = AffinityMode::Scatter;
+		return policy;
+	}
+
+	AffinityPolicy AffinityPolicy::Explicit(std::vector<int> cpus)
+	{
+		AffinityPolicy policy;
+		policy.mode = AffinityMode::Explicit;
+		policy.cpus = std::move(cpus);
+		return policy;
+	}
+
+	std::vector<int> GetAvailableCpus()
+	{
+		std::vector<int> cpus;
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (0 == sched_getaffinity(0, sizeof(set), &set))
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &set))
+				{
+					cpus.push_back(cpu);
+				}
+			}
+		}
+#endif
+		return cpus;
+	}
+
+	/***********************************************************************************************************************
+	* @brief Chooses the CPU of each thread of the pool.
+	*
+	* @details	Compact and Scatter give thread i the i-th CPU of the compact or the scatter order of the CPU
+	*	topology (see cpu_topology.h). With more threads than CPUs they start from the first CPU again. If the
+	*	topology is not known, both take the available CPUs in ascending order.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  const AffinityPolicy& policy - the pinning policy
+	* @param[in]  size_t threadCount - the number of threads
+	* @return std::vector<int> - threadCount CPU numbers, NO_CPU for a thread which is not pinned
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	std::vector<int> MapThreadsToCpus(const AffinityPolicy& policy, size_t threadCount)
+	{
+		std::vector<int> mapping(threadCount, NO_CPU);
+		if (AffinityMode::Explicit == policy.mode)
+		{
+			if (!policy.cpus.empty())
+			{
+				for (size_t i = 0; i < threadCount; i++)
+				{
+					mapping[i] = policy.cpus[i % policy.cpus.size()];
+				}
+			}
+			return mapping;
+		}
+
+		if (AffinityMode::None == policy.mode)
+		{
+			return mapping;
+		}
+
+		const CpuTopology topology = CpuTopology::Discover();
+		std::vector<int> order = AffinityMode::Compact == policy.mode
+			? topology.GetCompactOrder() : topology.GetScatterOrder();
+		if (order.empty())
+		{
+			order = GetAvailableCpus();
+		}
+		if (order.empty())
+		{
+			return mapping;
+		}
+
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			mapping[i] = order[i % order.size()];
+		}
+		return mapping;
+	}
+
+	bool PinThread(std::thread& thread, int cpu)
+	{
+		return PinThread(thread, std::vector<int>(1, cpu));
+	}
+
+#if defined(__linux__)
+	// the set of the given CPUs - false if any of them cannot be part of a cpu_set_t
+	static bool MakeCpuSet(const std::vector<int>& cpus, cpu_set_t& set)
+	{
+		CPU_ZERO(&set);
+		for (int cpu : cpus)
+		{
+			if (cpu < 0 || cpu >= CPU_SETSIZE)
+			{
+				return false;
+			}
+			CPU_SET(cpu, &set);
+		}
+		return !cpus.empty();
+	}
+#endif
+
+	bool PinThread(std::thread& thread, const std::vector<int>& cpus)
+	{
+		return PinThread(thread.native_handle(), cpus);
+	}
+
+	bool PinThread(std::thread::native_handle_type handle, const std::vector<int>& cpus)
+	{
+#if defined(__linux__)
+		cpu_set_t set;
+		return MakeCpuSet(cpus, set) && 0 == pthread_setaffinity_np(handle, sizeof(set), &set);
+#else
+		(void)handle;
+		(void)cpus;
+		return false;
+#endif
+	}
+
+	bool PinCurrentThread(const std::vector<int>& cpus)
+	{
+#if defined(__linux__)
+		cpu_set_t set;
+		return MakeCpuSet(cpus, set) && 0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+		(void)cpus;
+		return false;
+#endif
+	}
+
+	int GetCurrentCpu()
+	{
+#if defined(__linux__)
+		const int cpu = sched_getcpu();
+		return cpu < 0 ? NO_CPU : cpu;
+#else
+		return NO_CPU;
+#endif
+	}
+
+} // end of namespace CTP
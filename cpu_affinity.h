@@ -0,0 +1,86 @@
+/***********************************************************************************************************************
+* @file cpu_affinity.h
+*
+* @brief Pinning of the threads of the Thread Pool to CPUs.
+*
+* @details	 Unpinned threads are moved between the cores by the operating system, and each move leaves the warm
+*	L1 and L2 caches behind. The AffinityPolicy given in the ThreadPoolOptions pins each thread to one CPU:
+*
+*	- None		the threads are not pinned (the default)
+*	- Compact	the threads fill the CPUs core by core, L3 domain by L3 domain, socket by socket - including the
+*				SMT siblings - so that neighbouring threads share as much cache as possible
+*	- Scatter	the threads are spread over the sockets, the L3 domains and the physical cores first and use the
+*				SMT siblings last - each thread gets as much cache and memory bandwidth for itself as possible
+*	- Explicit	thread i is pinned to cpus[i % cpus.size()]
+*
+*	The available CPUs are the ones in the affinity mask of the process (e.g. limited by taskset), not simply
+*	all CPUs of the machine. Pinning is supported on Linux (pthread_setaffinity_np). On other systems the threads
+*	stay unpinned, which is visible in ThreadPool::GetWorkerCpus.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_CPU_AFFINITY_H
+#define CTP_CPU_AFFINITY_H
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace CTP
+{
+	// marks a thread which is not pinned to any CPU
+	static const int NO_CPU = -1;
+
+	enum class AffinityMode : size_t
+	{
+		None,
+		Compact,
+		Scatter,
+		Explicit
+	};
+
+	// how the threads of the pool are pinned to CPUs - see the top of this file
+	struct AffinityPolicy
+	{
+		AffinityMode mode = AffinityMode::None;
+
+		// Explicit only: the CPU numbers (as in /proc/cpuinfo) - thread i is pinned to cpus[i % cpus.size()]
+		std::vector<int> cpus;
+
+		static AffinityPolicy Compact();
+		static AffinityPolicy Scatter();
+		static AffinityPolicy Explicit(std::vector<int> cpus);
+	};
+
+	// the CPUs the calling process may run on, in ascending order. Empty if this is not known on the system
+	std::vector<int> GetAvailableCpus();
+
+	// the CPU for each of threadCount threads according to the policy - NO_CPU for the threads not to be pinned
+	std::vector<int> MapThreadsToCpus(const AffinityPolicy& policy, size_t threadCount);
+
+	// pins the thread to one CPU. Returns false if this failed or is not supported on the system
+	bool PinThread(std::thread& thread, int cpu);
+
+	// lets the thread run on any of the given CPUs - e.g. on all CPUs of one NUMA node
+	bool PinThread(std::thread& thread, const std::vector<int>& cpus);
+
+	// the same for a thread given by its handle - e.g. a thread not created by std::thread (see worker_thread.h)
+	bool PinThread(std::thread::native_handle_type handle, const std::vector<int>& cpus);
+
+	// the same for the calling thread
+	bool PinCurrentThread(const std::vector<int>& cpus);
+
+	// the CPU the calling thread runs on at the moment (sched_getcpu), NO_CPU if this is not known
+	int GetCurrentCpu();
+
+} // end of namespace CTP
+
+#endif // CTP_CPU_AFFINITY_H
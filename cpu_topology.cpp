@@ -0,0 +1,364 @@
+/***********************************************************************************************************************
+* @file cpu_topology.cpp
+*
+* @brief Discovery of the CPU topology - the implementation.
+*
+* @details	 See cpu_topology.h. Every file which cannot be read is replaced by the simplest assumption: no socket
+*	id - socket 0, no core id - a core of its own, no L3 cache - one L3 domain per socket, no NUMA nodes - node 0.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "cpu_topology.h"
+#include "cpu_affinity.h"
+#include "system_file.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace CTP
+{
+	static bool ReadNumber(const std::string& path, long& value)
+	{
+		std::string line;
+		if (!ReadFirstLine(path, line))
+		{
+			return false;
+		}
+		std::istringstream stream(line);
+		return static_cast<bool>(stream >> value);
+	}
+
+	// parses a CPU list in the format of /sys - e.g. "0-3,8,10-11"
+	static std::vector<int> ParseCpuList(const std::string& text)
+	{
+		std::vector<int> cpus;
+		std::istringstream stream(text);
+		std::string range;
+		while (std::getline(stream, range, ','))
+		{
+			int first = 0;
+			int last = 0;
+			char dash = 0;
+			std::istringstream rangeStream(range);
+			if (!(rangeStream >> first))
+			{
+				continue;
+			}
+			last = (rangeStream >> dash >> last && '-' == dash) ? last : first;
+			for (int cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+
+	// the lowest CPU sharing the level 3 cache with the given CPU, or -1 if there is no L3 cache
+	static long FindL3Key(const std::string& cpuPath)
+	{
+		for (int index = 0; ; index++)
+		{
+			const std::string cachePath = cpuPath + "/cache/index" + std::to_string(index);
+			long level = 0;
+			if (!ReadNumber(cachePath + "/level", level))
+			{
+				return -1;
+			}
+
+			std::string shared;
+			if (3 == level && ReadFirstLine(cachePath + "/shared_cpu_list", shared))
+			{
+				const std::vector<int> cpus = ParseCpuList(shared);
+				if (!cpus.empty())
+				{
+					return *std::min_element(cpus.begin(), cpus.end());
+				}
+			}
+		}
+	}
+
+	// the NUMA node id of each CPU - empty if the kernel reports no nodes
+	static std::map<int, long> ReadCpuNodes()
+	{
+		std::map<int, long> nodes;
+		std::string online;
+		if (!ReadFirstLine("/sys/devices/system/node/online", online))
+		{
+			return nodes;
+		}
+		for (int node : ParseCpuList(online))
+		{
+			std::string cpus;
+			if (ReadFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus))
+			{
+				for (int cpu : ParseCpuList(cpus))
+				{
+					nodes[cpu] = node;
+				}
+			}
+		}
+		return nodes;
+	}
+
+	CpuTopology::CpuTopology(std::vector<LogicalCpu> cpus)
+		: m_cpus(std::move(cpus))
+	{
+		std::sort(m_cpus.begin(), m_cpus.end(),
+			[](const LogicalCpu& a, const LogicalCpu& b) { return a.cpu < b.cpu; });
+	}
+
+	/***********************************************************************************************************************
+	* @brief Reads the topology of the CPUs the calling process may run on.
+	*
+	* @details	The CPUs are visited in ascending order, so the dense numbers of the sockets, cores and L3 domains
+	*	follow the order of their lowest CPU. The SMT index of a CPU is the number of CPUs of the same core seen
+	*	before it.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @return CpuTopology - empty if the available CPUs are not known on this system
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	CpuTopology CpuTopology::Discover()
+	{
+		const std::map<int, long> cpuNodes = ReadCpuNodes();
+
+		std::map<long, size_t> nodes;
+		std::map<long, size_t> sockets;
+		std::map<std::pair<long, long>, size_t> cores;
+		std::map<long, size_t> l3Domains;
+		std::map<size_t, size_t> siblingsSeen;
+
+		std::vector<LogicalCpu> cpus;
+		for (int cpu : GetAvailableCpus())
+		{
+			const std::string cpuPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+
+			long package = 0;
+			long coreId = 0;
+			ReadNumber(cpuPath + "/topology/physical_package_id", package);
+			if (!ReadNumber(cpuPath + "/topology/core_id", coreId))
+			{
+				// unknown - a core of its own. Negative, so it does not clash with the real ids
+				coreId = -1 - cpu;
+			}
+
+			// no L3 cache - the whole socket is one domain. The keys of such domains are negative as well
+			long l3Key = FindL3Key(cpuPath);
+			if (l3Key < 0)
+			{
+				l3Key = -1 - package;
+			}
+
+			const auto nodeId = cpuNodes.find(cpu);
+
+			LogicalCpu logical;
+			logical.cpu = cpu;
+			logical.node = nodes.insert(std::make_pair(cpuNodes.end() == nodeId ? 0L : nodeId->second, nodes.size())).first->second;
+			logical.socket = sockets.insert(std::make_pair(package, sockets.size())).first->second;
+			logical.core = cores.insert(std::make_pair(std::make_pair(package, coreId), cores.size())).first->second;
+			logical.l3Domain = l3Domains.insert(std::make_pair(l3Key, l3Domains.size())).first->second;
+			logical.smtIndex = siblingsSeen[logical.core]++;
+			cpus.push_back(logical);
+		}
+		return CpuTopology(std::move(cpus));
+	}
+
+	const std::vector<LogicalCpu>& CpuTopology::GetCpus() const
+	{
+		return m_cpus;
+	}
+
+	bool CpuTopology::IsEmpty() const
+	{
+		return m_cpus.empty();
+	}
+
+	size_t CpuTopology::GetLogicalCpuCount() const
+	{
+		return m_cpus.size();
+	}
+
+	size_t CpuTopology::GetPhysicalCoreCount() const
+	{
+		return GetPhysicalCoreCpus().size();
+	}
+
+	size_t CpuTopology::GetNodeCount() const
+	{
+		size_t count = 0;
+		for (const auto& cpu : m_cpus)
+		{
+			count = std::max(count, cpu.node + 1);
+		}
+		return count;
+	}
+
+	size_t CpuTopology::GetSocketCount() const
+	{
+		size_t count = 0;
+		for (const auto& cpu : m_cpus)
+		{
+			count = std::max(count, cpu.socket + 1);
+		}
+		return count;
+	}
+
+	size_t CpuTopology::GetL3Count() const
+	{
+		return GetL3Cpus().size();
+	}
+
+	size_t CpuTopology::GetSmtWidth() const
+	{
+		size_t width = 0;
+		for (const auto& cpu : m_cpus)
+		{
+			width = std::max(width, cpu.smtIndex + 1);
+		}
+		return width;
+	}
+
+	std::vector<int> CpuTopology::GetPhysicalCoreCpus() const
+	{
+		// in the compact order the first CPU of each core comes before its siblings
+		std::vector<int> result;
+		std::vector<bool> seen;
+		for (const auto& cpu : GetCompactCpus())
+		{
+			if (cpu.core >= seen.size())
+			{
+				seen.resize(cpu.core + 1, false);
+			}
+			if (!seen[cpu.core])
+			{
+				seen[cpu.core] = true;
+				result.push_back(cpu.cpu);
+			}
+		}
+		return result;
+	}
+
+	std::vector<int> CpuTopology::GetL3Cpus() const
+	{
+		std::vector<int> result;
+		std::vector<bool> seen;
+		for (const auto& cpu : GetCompactCpus())
+		{
+			if (cpu.l3Domain >= seen.size())
+			{
+				seen.resize(cpu.l3Domain + 1, false);
+			}
+			if (!seen[cpu.l3Domain])
+			{
+				seen[cpu.l3Domain] = true;
+				result.push_back(cpu.cpu);
+			}
+		}
+		return result;
+	}
+
+	std::vector<int> CpuTopology::GetNodeCpus(size_t node) const
+	{
+		std::vector<int> result;
+		for (const auto& cpu : GetCompactCpus())
+		{
+			if (node == cpu.node)
+			{
+				result.push_back(cpu.cpu);
+			}
+		}
+		return result;
+	}
+
+	std::vector<int> CpuTopology::GetCompactOrder() const
+	{
+		std::vector<int> order;
+		for (const auto& cpu : GetCompactCpus())
+		{
+			order.push_back(cpu.cpu);
+		}
+		return order;
+	}
+
+	std::vector<LogicalCpu> CpuTopology::GetCompactCpus() const
+	{
+		std::vector<LogicalCpu> sorted = m_cpus;
+		std::stable_sort(sorted.begin(), sorted.end(), [](const LogicalCpu& a, const LogicalCpu& b)
+		{
+			return std::make_tuple(a.socket, a.l3Domain, a.core, a.smtIndex)
+				< std::make_tuple(b.socket, b.l3Domain, b.core, b.smtIndex);
+		});
+		return sorted;
+	}
+
+	/***********************************************************************************************************************
+	* @brief All CPUs ordered so that neighbours share as little as possible.
+	*
+	* @details	Each CPU gets the rank of its core within its L3 domain and the rank of its L3 domain within its
+	*	socket. Sorting by (SMT index, core rank, domain rank, socket) takes the first core of the first domain of
+	*	every socket, then of the second domain of every socket and so on - and the SMT siblings come only after
+	*	all physical cores.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @return std::vector<int> - the CPU numbers in scatter order
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	std::vector<int> CpuTopology::GetScatterOrder() const
+	{
+		// the ranks are given in the compact order - the order of the lowest CPUs within each group
+		std::map<size_t, size_t> coreRank;
+		std::map<size_t, size_t> coresPerDomain;
+		std::map<size_t, size_t> domainRank;
+		std::map<size_t, size_t> domainsPerSocket;
+		for (const auto& cpu : GetCompactCpus())
+		{
+			if (0 == coreRank.count(cpu.core))
+			{
+				coreRank[cpu.core] = coresPerDomain[cpu.l3Domain]++;
+			}
+			if (0 == domainRank.count(cpu.l3Domain))
+			{
+				domainRank[cpu.l3Domain] = domainsPerSocket[cpu.socket]++;
+			}
+		}
+
+		std::vector<LogicalCpu> sorted = m_cpus;
+		std::stable_sort(sorted.begin(), sorted.end(), [&](const LogicalCpu& a, const LogicalCpu& b)
+		{
+			return std::make_tuple(a.smtIndex, coreRank[a.core], domainRank[a.l3Domain], a.socket)
+				< std::make_tuple(b.smtIndex, coreRank[b.core], domainRank[b.l3Domain], b.socket);
+		});
+
+		std::vector<int> order;
+		for (const auto& cpu : sorted)
+		{
+			order.push_back(cpu.cpu);
+		}
+		return order;
+	}
+
+} // end of namespace CTP
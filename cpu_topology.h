@@ -0,0 +1,111 @@
+/***********************************************************************************************************************
+* @file cpu_topology.h
+*
+* @brief Discovery of the CPU topology - NUMA nodes, sockets, L3 cache domains, physical cores and their SMT siblings.
+*
+* @details	 std::thread::hardware_concurrency() counts logical CPUs - with Hyperthreading (SMT) two or more per
+*	physical core. For memory bound jobs a second thread per core brings nothing but a share of the same caches,
+*	so the number of physical cores or of L3 cache domains is often the better thread count.
+*
+*	On Linux the topology is read from /sys/devices/system/cpu:
+*
+*	- cpuN/topology/physical_package_id	- the socket
+*	- cpuN/topology/core_id				- the core within the socket. The CPUs with the same socket and core are
+*										  SMT siblings of one physical core
+*	- cpuN/cache/indexK/level and shared_cpu_list - the CPUs sharing the level 3 cache
+*	- ../node/online and nodeK/cpulist	- the CPUs of each NUMA node, the ones with their memory closest.
+*										  Without these files all CPUs are on node 0
+*
+*	Only the CPUs the process may run on (its affinity mask) are included. Nodes, sockets, cores and L3 domains are
+*	numbered densely from 0 in the order of their lowest CPU. On other systems, or if /sys is not readable, the
+*	topology is empty.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_CPU_TOPOLOGY_H
+#define CTP_CPU_TOPOLOGY_H
+
+#include <cstddef>
+#include <vector>
+
+namespace CTP
+{
+	// one logical CPU - what the operating system schedules a thread on
+	struct LogicalCpu
+	{
+		int cpu;			// the CPU number as in /proc/cpuinfo
+		size_t socket;
+		size_t l3Domain;	// the CPUs with the same l3Domain share one L3 cache
+		size_t core;		// the physical core - unique in the whole machine, not only within the socket
+		size_t smtIndex;	// 0 for the first CPU of its core, 1 for its first SMT sibling and so on
+		size_t node;		// the NUMA node - the memory of this node is the closest to the CPU
+	};
+
+	class CpuTopology
+	{
+	public:
+		// a topology of the given CPUs - e.g. for tests. Discover reads the real one
+		explicit CpuTopology(std::vector<LogicalCpu> cpus = std::vector<LogicalCpu>());
+
+		//-----------------------------------------------------------------------------
+		/// Reads the topology of the CPUs the calling process may run on. Empty if unknown.
+		//-----------------------------------------------------------------------------
+		static CpuTopology Discover();
+
+		// the CPUs ordered by their CPU number
+		const std::vector<LogicalCpu>& GetCpus() const;
+
+		bool IsEmpty() const;
+
+		size_t GetLogicalCpuCount() const;
+		size_t GetNodeCount() const;
+		size_t GetPhysicalCoreCount() const;
+		size_t GetSocketCount() const;
+		size_t GetL3Count() const;
+
+		// the most logical CPUs of one physical core - 1 without SMT
+		size_t GetSmtWidth() const;
+
+		// the first CPU of each physical core - one thread on each of these uses all cores without SMT sharing
+		std::vector<int> GetPhysicalCoreCpus() const;
+
+		// the first CPU of each L3 domain
+		std::vector<int> GetL3Cpus() const;
+
+		// all CPUs of the given NUMA node in the compact order
+		std::vector<int> GetNodeCpus(size_t node) const;
+
+		//-----------------------------------------------------------------------------
+		/// All CPUs ordered so that neighbours share as much as possible.
+		//
+		// Socket by socket, L3 domain by L3 domain, core by core - the SMT siblings of
+		// a core are next to each other.
+		//-----------------------------------------------------------------------------
+		std::vector<int> GetCompactOrder() const;
+
+		//-----------------------------------------------------------------------------
+		/// All CPUs ordered so that neighbours share as little as possible.
+		//
+		// First one CPU of each physical core, going round robin over the L3 domains
+		// (and so over the sockets), then the second SMT siblings the same way, etc.
+		//-----------------------------------------------------------------------------
+		std::vector<int> GetScatterOrder() const;
+
+	private:
+		// the CPUs in the compact order
+		std::vector<LogicalCpu> GetCompactCpus() const;
+
+		std::vector<LogicalCpu> m_cpus;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_CPU_TOPOLOGY_H
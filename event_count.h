@@ -0,0 +1,195 @@
+/***********************************************************************************************************************
+* @file event_count.h
+*
+* @brief Event count - lets the idle threads of the pool sleep without a mutex on the path of adding a job.
+*
+* @details	 With a condition variable every thread adding a job has to lock the mutex and notify, whether anybody
+*	sleeps or not, and a sleeping thread checks its wait condition under the same mutex. The event count splits
+*	sleeping in two steps, so the condition can be checked with no lock at all:
+*
+*		key = PrepareWait();		// announce "I am going to sleep"
+*		if (condition) CancelWait();	// re-check after the announcement - work came in meanwhile
+*		else Wait(key);				// sleep until a Notify after PrepareWait
+*
+*	and the notifying side, after making the condition true, calls Notify - which costs one atomic load when
+*	nobody waits. Both sides use sequentially consistent operations (the announcement and the re-check on one
+*	side, the change of the condition and the check for waiters on the other), so either the notifier sees the
+*	waiter or the waiter sees the new condition - a wake up is never lost.
+*
+*	A Notify increments the epoch, so a thread between PrepareWait and Wait does not sleep at all. On Linux the
+*	thread sleeps with the futex system call directly on the epoch. Everywhere else a mutex and a condition
+*	variable are used, but only by the threads which really sleep or wake somebody up.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_EVENT_COUNT_H
+#define CTP_EVENT_COUNT_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace CTP
+{
+	class EventCount
+	{
+	public:
+		typedef uint32_t Key;
+
+		EventCount()
+			: m_epoch(0)
+			, m_waiters(0)
+		{
+		}
+
+		EventCount(const EventCount&) = delete;
+		EventCount& operator=(const EventCount&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Announces that the calling thread is going to sleep. Re-check the condition after it.
+		//-----------------------------------------------------------------------------
+		Key PrepareWait()
+		{
+			m_waiters.fetch_add(1, std::memory_order_seq_cst);
+			return m_epoch.load(std::memory_order_seq_cst);
+		}
+
+		// the condition became true after PrepareWait - the thread does not sleep
+		void CancelWait()
+		{
+			m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Sleeps until Notify is called after the PrepareWait which returned key.
+		//-----------------------------------------------------------------------------
+		void Wait(Key key)
+		{
+#if defined(__linux__)
+			// the futex sleeps only if the epoch still equals key - a Notify in between is never missed.
+			// The loop covers the spurious returns of the system call
+			while (m_epoch.load(std::memory_order_acquire) == key)
+			{
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+			}
+#else
+			std::unique_lock<std::mutex> ul(m_guard);
+			m_cvEpoch.wait(ul, [this, key]() { return m_epoch.load(std::memory_order_acquire) != key; });
+#endif
+			m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Sleeps as Wait, but not longer than timeout. Returns false if the time ran out.
+		//
+		// A thread returning false has left the waiters before it reads anything else, so
+		// a Notify either counts it as woken up or the thread sees what that Notify
+		// announced - see ThreadPool::impl::TryRetire.
+		//-----------------------------------------------------------------------------
+		bool WaitFor(Key key, std::chrono::nanoseconds timeout)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			bool notified = true;
+#if defined(__linux__)
+			while (m_epoch.load(std::memory_order_acquire) == key)
+			{
+				const auto left = deadline - std::chrono::steady_clock::now();
+				if (left <= std::chrono::nanoseconds::zero())
+				{
+					notified = false;
+					break;
+				}
+				const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(left);
+				timespec relative;
+				relative.tv_sec = static_cast<time_t>(seconds.count());
+				relative.tv_nsec = static_cast<long>((left - seconds).count());
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, key, &relative, nullptr, 0);
+			}
+#else
+			std::unique_lock<std::mutex> ul(m_guard);
+			notified = m_cvEpoch.wait_until(ul, deadline,
+				[this, key]() { return m_epoch.load(std::memory_order_acquire) != key; });
+#endif
+			m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+			return notified;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Wakes up to count sleeping threads. Call it after making the condition true.
+		//
+		// If no thread has announced to sleep this is one atomic load - no system call.
+		// Returns the number of threads which may have been woken up - 0 if none was
+		// waiting, so that the caller can wake up threads waiting elsewhere instead.
+		//-----------------------------------------------------------------------------
+		size_t Notify(size_t count)
+		{
+			const size_t waiters = m_waiters.load(std::memory_order_seq_cst);
+			if (0 == waiters)
+			{
+				return 0;
+			}
+
+#if defined(__linux__)
+			m_epoch.fetch_add(1, std::memory_order_seq_cst);
+			const int wake = count < static_cast<size_t>(INT_MAX) ? static_cast<int>(count) : INT_MAX;
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, wake, nullptr, nullptr, 0);
+#else
+			{
+				// locking guarantees a waiter is either before its check of the epoch or really waiting
+				std::unique_lock<std::mutex> ul(m_guard);
+				m_epoch.fetch_add(1, std::memory_order_seq_cst);
+			}
+			if (count > 1)
+			{
+				m_cvEpoch.notify_all();
+			}
+			else
+			{
+				m_cvEpoch.notify_one();
+			}
+#endif
+			return waiters < count ? waiters : count;
+		}
+
+		// wakes up all sleeping threads
+		void NotifyAll()
+		{
+			Notify(static_cast<size_t>(INT_MAX));
+		}
+
+	private:
+		// incremented by each Notify which finds a waiter. The futex sleeps on it, so it must be 32 bit
+		std::atomic<uint32_t> m_epoch;
+
+		// the threads between PrepareWait and the end of Wait or CancelWait
+		std::atomic<uint32_t> m_waiters;
+
+#if !defined(__linux__)
+		std::mutex m_guard;
+		std::condition_variable m_cvEpoch;
+#endif
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_EVENT_COUNT_H
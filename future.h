@@ -0,0 +1,844 @@
+/***********************************************************************************************************************
+* @file future.h
+*
+* @brief Future with non blocking continuations for the Thread Pool - Then, WhenAll and WhenAny.
+*
+* @details	 The std::future returned by Schedule can only be waited on. Chaining work with it means a thread sits
+*	blocked in get() until the previous result is ready. CTP::Future<T> (returned by ThreadPool::ScheduleAsync)
+*	can in addition be continued:
+*
+*	- Then(f) returns a Future of the result of f(value). When the value is ready, f is added to the pool with
+*	  the priority of the parent (or the one given explicitly) - nobody waits for it. If the parent failed, f is
+*	  not called and the exception is passed on to the returned Future.
+*	- WhenAll(futures) returns a Future of all values, ready when all inputs are ready.
+*	- WhenAny(futures) returns a Future of the index of the first ready input together with all the inputs.
+*
+*	As std::future the Future is move only and Get and Then consume it - there is one consumer of the value.
+*
+*	The shared state is guarded by a mutex. The continuations are kept in the state and are started by the thread
+*	which sets the value (or immediately by Then if the value is already there). A job which is destroyed without
+*	being executed - e.g. because the pool was shut down - leaves a std::future_error(broken_promise) in its
+*	Future, exactly as std::packaged_task does, so the waiters and the continuations are never stuck.
+*
+*	A Future may outlive its pool. The pool cuts the link of its futures to it when it shuts down - Get on such
+*	a Future just blocks until the state is ready, and a continuation added to it is dropped (broken_promise).
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_FUTURE_H
+#define CTP_FUTURE_H
+
+#include "job.h"
+#include "slab_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CTP
+{
+	class ThreadPool;
+	enum class Priority : size_t;
+
+	template <typename T>
+	class Future;
+
+	// The way from a future to its pool (see thread_pool.cpp). The futures share it with the pool, which clears
+	// it when it shuts down - a Future which outlives its pool does not reach the destroyed pool then: its
+	// continuations are dropped (broken_promise) and Get blocks as on any other thread
+	class PoolLink;
+
+	// adds a job to the pool of the link - the continuations use this, as the pool is only forward declared here.
+	// The job is destroyed instead if the pool has shut down already
+	void PostContinuation(PoolLink& link, Job&& job, Priority priority);
+
+	// true if the calling thread is one of the threads of the pool - false once the pool has shut down
+	bool IsWorkerThread(const ThreadPool& pool);
+	bool IsWorkerThread(const PoolLink& link);
+
+	// executes one queued job of the pool on the calling thread if it is a thread of the pool - see
+	// ThreadPool::RunPendingJob
+	bool RunPendingJob(ThreadPool& pool);
+	bool RunPendingJob(PoolLink& link);
+
+	//-----------------------------------------------------------------------------
+	/// Waits until isReady() is true - executing the queued jobs of the pool meanwhile.
+	//
+	// A result which is ready already returns at once - the pool is not touched then.
+	// A thread which is not a thread of the pool (or a null pool) simply blocks in
+	// wait(). A thread of the pool instead executes the queued jobs, highest priority
+	// first, until the result is ready. If there is nothing to execute it blocks in
+	// waitFor(timeout) for a short time only and looks again - the job it waits for
+	// may itself add jobs which nobody else is free to execute. The timeout doubles
+	// up to 1 ms while there is nothing to do.
+	//-----------------------------------------------------------------------------
+	template <typename Pool, typename IsReady, typename Wait, typename WaitFor>
+	void CooperativeWait(Pool* pool, const IsReady& isReady, const Wait& wait, const WaitFor& waitFor)
+	{
+		if (isReady())
+		{
+			return;
+		}
+		if (nullptr == pool || !IsWorkerThread(*pool))
+		{
+			wait();
+			return;
+		}
+
+		const std::chrono::microseconds minTimeout(20);
+		const std::chrono::microseconds maxTimeout(1000);
+		std::chrono::microseconds timeout = minTimeout;
+		while (!isReady())
+		{
+			if (RunPendingJob(*pool))
+			{
+				timeout = minTimeout;
+				continue;
+			}
+			waitFor(timeout);
+			timeout = std::min(timeout * 2, maxTimeout);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	/// The storage of the value of a FutureState - empty until the value is set.
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	class FutureValue
+	{
+	public:
+		FutureValue()
+			: m_hasValue(false)
+		{
+		}
+
+		~FutureValue()
+		{
+			if (m_hasValue)
+			{
+				reinterpret_cast<T*>(&m_storage)->~T();
+			}
+		}
+
+		template <typename V>
+		void Set(V&& value)
+		{
+			new (&m_storage) T(std::forward<V>(value));
+			m_hasValue = true;
+		}
+
+		T Take()
+		{
+			return std::move(*reinterpret_cast<T*>(&m_storage));
+		}
+
+	private:
+		typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type m_storage;
+		bool m_hasValue;
+	};
+
+	template <>
+	class FutureValue<void>
+	{
+	public:
+		void Set()
+		{
+		}
+
+		void Take()
+		{
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The state shared between a Future, the job producing its value and the continuations.
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	class FutureState : public std::enable_shared_from_this<FutureState<T>>
+	{
+	public:
+		// link may be null - the continuations are then executed directly on the thread setting the value
+		FutureState(std::shared_ptr<PoolLink> link, Priority priority)
+			: m_ready(false)
+			, m_link(std::move(link))
+			, m_priority(priority)
+		{
+		}
+
+		FutureState(const FutureState&) = delete;
+		FutureState& operator=(const FutureState&) = delete;
+
+		// sets the value and starts the continuations. A second value or exception is ignored
+		template <typename... V>
+		void SetValue(V&&... value)
+		{
+			std::unique_lock<std::mutex> ul(m_guard);
+			if (m_ready.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+			m_value.Set(std::forward<V>(value)...);
+			MarkReady(ul);
+		}
+
+		// sets the exception and starts the continuations. A second value or exception is ignored
+		void SetException(std::exception_ptr exception)
+		{
+			std::unique_lock<std::mutex> ul(m_guard);
+			if (m_ready.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+			m_exception = exception;
+			MarkReady(ul);
+		}
+
+		bool IsReady() const
+		{
+			return m_ready.load(std::memory_order_acquire);
+		}
+
+		// blocks until the state is ready. A thread of the pool executes queued jobs meanwhile
+		void Wait()
+		{
+			CooperativeWait(m_link.get(),
+				[this]() { return IsReady(); },
+				[this]()
+				{
+					std::unique_lock<std::mutex> ul(m_guard);
+					m_cvReady.wait(ul, [this]() { return m_ready.load(std::memory_order_relaxed); });
+				},
+				[this](std::chrono::microseconds timeout)
+				{
+					std::unique_lock<std::mutex> ul(m_guard);
+					m_cvReady.wait_for(ul, timeout, [this]() { return m_ready.load(std::memory_order_relaxed); });
+				});
+		}
+
+		// moves the value out or rethrows the exception. The state must be ready
+		T TakeValue()
+		{
+			if (m_exception)
+			{
+				std::rethrow_exception(m_exception);
+			}
+			return m_value.Take();
+		}
+
+		bool HasException() const
+		{
+			return m_exception != nullptr;
+		}
+
+		std::exception_ptr GetException() const
+		{
+			return m_exception;
+		}
+
+		// the continuation is executed once the state is ready - immediately if it already is
+		void AddContinuation(Job&& continuation)
+		{
+			{
+				std::unique_lock<std::mutex> ul(m_guard);
+				if (!m_ready.load(std::memory_order_relaxed))
+				{
+					m_continuations.push_back(std::move(continuation));
+					return;
+				}
+			}
+			continuation();
+		}
+
+		const std::shared_ptr<PoolLink>& GetLink() const
+		{
+			return m_link;
+		}
+
+		Priority GetPriority() const
+		{
+			return m_priority;
+		}
+
+	private:
+		// called with the lock held - releases it before running the continuations
+		void MarkReady(std::unique_lock<std::mutex>& ul)
+		{
+			m_ready.store(true, std::memory_order_release);
+			std::vector<Job> continuations;
+			continuations.swap(m_continuations);
+			ul.unlock();
+
+			m_cvReady.notify_all();
+			for (auto& continuation : continuations)
+			{
+				continuation();
+			}
+		}
+
+		std::mutex m_guard;
+		std::condition_variable m_cvReady;
+		std::atomic<bool> m_ready;
+		std::exception_ptr m_exception;
+		FutureValue<T> m_value;
+		std::vector<Job> m_continuations;
+		const std::shared_ptr<PoolLink> m_link;
+		const Priority m_priority;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// Calls a function and stores its result (or its exception) in a FutureState.
+	//-----------------------------------------------------------------------------
+	template <typename R>
+	struct FutureResultSetter
+	{
+		template <typename F, typename... A>
+		static void Run(FutureState<R>& state, F& f, A&&... args)
+		{
+			try
+			{
+				state.SetValue(f(std::forward<A>(args)...));
+			}
+			catch (...)
+			{
+				state.SetException(std::current_exception());
+			}
+		}
+	};
+
+	template <>
+	struct FutureResultSetter<void>
+	{
+		template <typename F, typename... A>
+		static void Run(FutureState<void>& state, F& f, A&&... args)
+		{
+			try
+			{
+				f(std::forward<A>(args)...);
+				state.SetValue();
+			}
+			catch (...)
+			{
+				state.SetException(std::current_exception());
+			}
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The job producing the value of a Future. If it is destroyed without being
+	/// executed, the Future gets std::future_error(broken_promise).
+	//-----------------------------------------------------------------------------
+	template <typename R, typename F>
+	class FutureTask
+	{
+	public:
+		FutureTask(std::shared_ptr<FutureState<R>> state, F&& f)
+			: m_state(std::move(state))
+			, m_function(std::move(f))
+		{
+		}
+
+		FutureTask(FutureTask&& other) noexcept
+			: m_state(std::move(other.m_state))
+			, m_function(std::move(other.m_function))
+		{
+		}
+
+		~FutureTask()
+		{
+			if (m_state)
+			{
+				m_state->SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			}
+		}
+
+		void operator()()
+		{
+			std::shared_ptr<FutureState<R>> state = std::move(m_state);
+			FutureResultSetter<R>::Run(*state, m_function);
+		}
+
+	private:
+		std::shared_ptr<FutureState<R>> m_state;
+		F m_function;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// Calls a function and stores its result (or its exception) in a std::promise.
+	//-----------------------------------------------------------------------------
+	template <typename R>
+	struct PromiseResultSetter
+	{
+		template <typename F>
+		static void Run(std::promise<R>& promise, F& f)
+		{
+			try
+			{
+				promise.set_value(f());
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+		}
+	};
+
+	template <>
+	struct PromiseResultSetter<void>
+	{
+		template <typename F>
+		static void Run(std::promise<void>& promise, F& f)
+		{
+			try
+			{
+				f();
+				promise.set_value();
+			}
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The job producing the value of a std::future - used by Schedule instead of a
+	/// std::packaged_task, as its shared state can come from the SlabAllocator (the
+	/// allocator constructor of std::packaged_task is gone since C++17). If it is
+	/// destroyed without being executed, the promise leaves broken_promise.
+	//-----------------------------------------------------------------------------
+	template <typename R, typename F>
+	class PromiseTask
+	{
+	public:
+		PromiseTask(std::promise<R>&& promise, F&& f)
+			: m_promise(std::move(promise))
+			, m_function(std::move(f))
+		{
+		}
+
+		PromiseTask(PromiseTask&& other) noexcept
+			: m_promise(std::move(other.m_promise))
+			, m_function(std::move(other.m_function))
+		{
+		}
+
+		void operator()()
+		{
+			PromiseResultSetter<R>::Run(m_promise, m_function);
+		}
+
+	private:
+		std::promise<R> m_promise;
+		F m_function;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// A promise whose shared state comes from the SlabAllocator - see slab_allocator.h
+	//-----------------------------------------------------------------------------
+	template <typename R>
+	std::promise<R> MakeSlabPromise()
+	{
+		return std::promise<R>(std::allocator_arg, SlabAllocator<R>());
+	}
+
+	//-----------------------------------------------------------------------------
+	/// The job of a continuation - calls f with the value of the parent
+	//-----------------------------------------------------------------------------
+	template <typename T, typename R, typename F>
+	class ContinuationTask
+	{
+	public:
+		ContinuationTask(std::shared_ptr<FutureState<T>> parent, std::shared_ptr<FutureState<R>> child, F&& f)
+			: m_parent(std::move(parent))
+			, m_child(std::move(child))
+			, m_function(std::move(f))
+		{
+		}
+
+		ContinuationTask(ContinuationTask&& other) noexcept
+			: m_parent(std::move(other.m_parent))
+			, m_child(std::move(other.m_child))
+			, m_function(std::move(other.m_function))
+		{
+		}
+
+		~ContinuationTask()
+		{
+			if (m_child)
+			{
+				m_child->SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			}
+		}
+
+		void operator()()
+		{
+			std::shared_ptr<FutureState<R>> child = std::move(m_child);
+			if (m_parent->HasException())
+			{
+				child->SetException(m_parent->GetException());
+				return;
+			}
+			Call(*child, std::is_void<T>());
+		}
+
+	private:
+		void Call(FutureState<R>& child, std::false_type /*void parent*/)
+		{
+			FutureResultSetter<R>::Run(child, m_function, m_parent->TakeValue());
+		}
+
+		void Call(FutureState<R>& child, std::true_type /*void parent*/)
+		{
+			FutureResultSetter<R>::Run(child, m_function);
+		}
+
+		std::shared_ptr<FutureState<T>> m_parent;
+		std::shared_ptr<FutureState<R>> m_child;
+		F m_function;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The continuation kept in the parent state. Once the parent is ready it adds
+	/// the ContinuationTask to the pool (or runs it directly when there is no pool).
+	//
+	// It holds only a raw pointer to the parent - the parent is alive while it runs
+	// its continuations, and a shared pointer would form a cycle parent - continuation.
+	//-----------------------------------------------------------------------------
+	template <typename T, typename R, typename F>
+	class ContinuationLauncher
+	{
+	public:
+		ContinuationLauncher(FutureState<T>* parent, std::shared_ptr<FutureState<R>> child, F&& f)
+			: m_parent(parent)
+			, m_child(std::move(child))
+			, m_function(std::move(f))
+		{
+		}
+
+		ContinuationLauncher(ContinuationLauncher&& other) noexcept
+			: m_parent(other.m_parent)
+			, m_child(std::move(other.m_child))
+			, m_function(std::move(other.m_function))
+		{
+		}
+
+		~ContinuationLauncher()
+		{
+			if (m_child)
+			{
+				m_child->SetException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+			}
+		}
+
+		void operator()()
+		{
+			// a copy - the task may be destroyed right away if the pool is gone, together with the child
+			const std::shared_ptr<PoolLink> link = m_child->GetLink();
+			const Priority priority = m_child->GetPriority();
+			ContinuationTask<T, R, F> task(m_parent->shared_from_this(), std::move(m_child), std::move(m_function));
+			if (link != nullptr)
+			{
+				PostContinuation(*link, Job(std::move(task)), priority);
+			}
+			else
+			{
+				task();
+			}
+		}
+
+	private:
+		FutureState<T>* m_parent;
+		std::shared_ptr<FutureState<R>> m_child;
+		F m_function;
+	};
+
+	// the result type of a continuation f of a Future<T> - f(T) or f() for a Future<void>
+	template <typename T, typename F>
+	struct ContinuationResult
+	{
+		typedef typename std::result_of<F(T)>::type type;
+	};
+
+	template <typename F>
+	struct ContinuationResult<void, F>
+	{
+		typedef typename std::result_of<F()>::type type;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The result of WhenAny - the index of the first ready future and all the futures
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	struct WhenAnyResult
+	{
+		size_t index;
+		std::vector<Future<T>> futures;
+	};
+
+	template <typename T>
+	class Future
+	{
+	public:
+		Future()
+		{
+		}
+
+		explicit Future(std::shared_ptr<FutureState<T>> state)
+			: m_state(std::move(state))
+		{
+		}
+
+		Future(Future&&) = default;
+		Future& operator=(Future&&) = default;
+
+		Future(const Future&) = delete;
+		Future& operator=(const Future&) = delete;
+
+		// false for a default constructed or a consumed Future
+		bool Valid() const
+		{
+			return m_state != nullptr;
+		}
+
+		bool IsReady() const
+		{
+			return m_state->IsReady();
+		}
+
+		// blocks until the value is ready - on a thread of the pool executing the queued jobs meanwhile
+		void Wait() const
+		{
+			m_state->Wait();
+		}
+
+		// blocks until the value is ready, then returns it or rethrows the exception. Consumes the Future
+		T Get()
+		{
+			std::shared_ptr<FutureState<T>> state = std::move(m_state);
+			state->Wait();
+			return state->TakeValue();
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Continues with f(value) on the pool with the priority of this Future. Consumes the Future.
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		auto Then(F&& f) -> Future<typename ContinuationResult<T, typename std::decay<F>::type>::type>
+		{
+			const Priority priority = m_state->GetPriority();
+			return Then(priority, std::forward<F>(f));
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Continues with f(value) on the pool with the given priority. Consumes the Future.
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		auto Then(Priority priority, F&& f) -> Future<typename ContinuationResult<T, typename std::decay<F>::type>::type>
+		{
+			typedef typename std::decay<F>::type Function;
+			typedef typename ContinuationResult<T, Function>::type Result;
+
+			std::shared_ptr<FutureState<T>> parent = std::move(m_state);
+			auto child = std::allocate_shared<FutureState<Result>>(SlabAllocator<FutureState<Result>>(),
+				parent->GetLink(), priority);
+			parent->AddContinuation(Job(
+				ContinuationLauncher<T, Result, Function>(parent.get(), child, Function(std::forward<F>(f)))));
+			return Future<Result>(child);
+		}
+
+		// the shared state - used by WhenAll and WhenAny
+		const std::shared_ptr<FutureState<T>>& GetState() const
+		{
+			return m_state;
+		}
+
+	private:
+		std::shared_ptr<FutureState<T>> m_state;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// Moves the values of ready states into a vector - the WhenAll result for T and void.
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	struct WhenAllCollector
+	{
+		typedef std::vector<T> ResultType;
+
+		static void Complete(FutureState<ResultType>& result, std::vector<std::shared_ptr<FutureState<T>>>& inputs)
+		{
+			ResultType values;
+			values.reserve(inputs.size());
+			for (auto& input : inputs)
+			{
+				if (input->HasException())
+				{
+					result.SetException(input->GetException());
+					return;
+				}
+				values.push_back(input->TakeValue());
+			}
+			result.SetValue(std::move(values));
+		}
+	};
+
+	template <>
+	struct WhenAllCollector<void>
+	{
+		typedef void ResultType;
+
+		static void Complete(FutureState<void>& result, std::vector<std::shared_ptr<FutureState<void>>>& inputs)
+		{
+			for (auto& input : inputs)
+			{
+				if (input->HasException())
+				{
+					result.SetException(input->GetException());
+					return;
+				}
+			}
+			result.SetValue();
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	/// Returns a Future ready when all the given futures are ready. Its value is the vector of
+	/// their values in the same order (nothing for Future<void>), or the first exception in
+	/// that order. Consumes the futures. Nobody is blocked while waiting.
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	Future<typename WhenAllCollector<T>::ResultType> WhenAll(std::vector<Future<T>> futures)
+	{
+		typedef typename WhenAllCollector<T>::ResultType ResultType;
+
+		// the state shared by the continuations of all inputs - the last one to finish collects the values
+		struct Aggregate
+		{
+			std::vector<std::shared_ptr<FutureState<T>>> inputs;
+			std::atomic<size_t> remaining;
+			std::shared_ptr<FutureState<ResultType>> result;
+		};
+
+		std::shared_ptr<PoolLink> link;
+		if (!futures.empty())
+		{
+			link = futures.front().GetState()->GetLink();
+		}
+		Priority priority = futures.empty() ? Priority() : futures.front().GetState()->GetPriority();
+
+		auto aggregate = std::make_shared<Aggregate>();
+		aggregate->result = std::make_shared<FutureState<ResultType>>(link, priority);
+		aggregate->remaining = futures.size();
+		for (auto& future : futures)
+		{
+			aggregate->inputs.push_back(future.GetState());
+		}
+		Future<ResultType> result(aggregate->result);
+
+		if (futures.empty())
+		{
+			WhenAllCollector<T>::Complete(*aggregate->result, aggregate->inputs);
+			return result;
+		}
+
+		// the same ownership cycle as in WhenAny - broken once every input is ready
+		for (auto& input : aggregate->inputs)
+		{
+			input->AddContinuation(Job([aggregate]()
+			{
+				if (1 == aggregate->remaining.fetch_sub(1, std::memory_order_acq_rel))
+				{
+					WhenAllCollector<T>::Complete(*aggregate->result, aggregate->inputs);
+				}
+			}));
+		}
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------
+	/// Returns a Future ready when any of the given futures is ready. Its value holds the index
+	/// of the first ready future and all the futures, so that the value can be taken from
+	/// there. Consumes the futures. For an empty input the Future is ready at once with
+	/// the index size_t(-1).
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	Future<WhenAnyResult<T>> WhenAny(std::vector<Future<T>> futures)
+	{
+		// the state shared by the continuations of all inputs - the first one to finish sets the result
+		struct Aggregate
+		{
+			std::vector<std::shared_ptr<FutureState<T>>> inputs;
+			std::atomic<bool> done;
+			std::shared_ptr<FutureState<WhenAnyResult<T>>> result;
+
+			void Complete(size_t index)
+			{
+				if (done.exchange(true, std::memory_order_acq_rel))
+				{
+					return;
+				}
+				WhenAnyResult<T> value;
+				value.index = index;
+				for (auto& input : inputs)
+				{
+					value.futures.push_back(Future<T>(input));
+				}
+				result->SetValue(std::move(value));
+			}
+		};
+
+		std::shared_ptr<PoolLink> link;
+		if (!futures.empty())
+		{
+			link = futures.front().GetState()->GetLink();
+		}
+		Priority priority = futures.empty() ? Priority() : futures.front().GetState()->GetPriority();
+
+		auto aggregate = std::make_shared<Aggregate>();
+		aggregate->done = false;
+		aggregate->result = std::make_shared<FutureState<WhenAnyResult<T>>>(link, priority);
+		for (auto& future : futures)
+		{
+			aggregate->inputs.push_back(future.GetState());
+		}
+		Future<WhenAnyResult<T>> result(aggregate->result);
+
+		if (futures.empty())
+		{
+			aggregate->Complete(static_cast<size_t>(-1));
+			return result;
+		}
+
+		// the continuations own the aggregate, which owns the inputs - this cycle is broken as each input becomes
+		// ready and drops its continuations, which always happens (see FutureTask)
+		for (size_t index = 0; index < aggregate->inputs.size(); index++)
+		{
+			aggregate->inputs[index]->AddContinuation(Job([aggregate, index]()
+			{
+				aggregate->Complete(index);
+			}));
+		}
+		return result;
+	}
+
+} // end of namespace CTP
+
+#endif // CTP_FUTURE_H
@@ -0,0 +1,131 @@
+/***********************************************************************************************************************
+* @file hill_climbing.h
+*
+* @brief Tuning of the thread count by hill climbing on the throughput - the completed jobs per second.
+*
+* @details	 The best number of threads depends on the jobs: CPU bound jobs want one thread per core, jobs which
+*	block now and then (a lock, a short I/O) want more, so that the cores have something to do while some threads
+*	wait. Instead of guessing, the controller tries - similar to the thread injection of the .NET thread pool:
+*
+*	- every tuning interval the completed jobs per second are measured
+*	- if the last change of the thread count made the throughput better, the next change goes the same way
+*	- if it made the throughput worse, the next change goes back
+*	- if the throughput stayed the same (within a margin of noise), fewer threads are tried - they do the same work
+*	  with less memory and fewer context switches
+*	- if no job is waiting more threads cannot help - the thread count is held
+*
+*	The thread count moves by one thread per interval between the minimum and the maximum. Around the best thread
+*	count it keeps oscillating by one - the price of noticing when the jobs change their character.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_HILL_CLIMBING_H
+#define CTP_HILL_CLIMBING_H
+
+#include <cstddef>
+
+namespace CTP
+{
+	// what the controller did at its last step
+	enum class ThreadCountDecision : size_t
+	{
+		None,	// no step yet
+		Hold,	// no job is waiting, or the thread count is at its bound
+		Grow,
+		Shrink
+	};
+
+	class HillClimbing
+	{
+	public:
+		// margin - the relative change of the throughput which still counts as noise
+		HillClimbing(size_t minThreads, size_t maxThreads, double margin = 0.05)
+			: m_minThreads(minThreads)
+			, m_maxThreads(maxThreads)
+			, m_margin(margin)
+		{
+		}
+
+		//-----------------------------------------------------------------------------
+		/// One step of the controller. Returns the thread count for the next interval.
+		//
+		// threads - the thread count during the last interval, throughput - the jobs
+		// completed per second in it, jobsWaiting - if jobs are queued right now.
+		//-----------------------------------------------------------------------------
+		size_t Update(size_t threads, double throughput, bool jobsWaiting)
+		{
+			if (m_lastThroughput >= 0)
+			{
+				if (throughput < m_lastThroughput * (1 - m_margin))
+				{
+					// the last change made it worse - go back
+					m_direction = -m_direction;
+				}
+				else if (throughput <= m_lastThroughput * (1 + m_margin))
+				{
+					// no real difference - fewer threads do the same work
+					m_direction = -1;
+				}
+			}
+			m_lastThroughput = throughput;
+
+			// without waiting jobs the threads keep up - a change could not be judged by the throughput
+			size_t target = threads;
+			if (!jobsWaiting)
+			{
+				m_lastDecision = ThreadCountDecision::Hold;
+				return target;
+			}
+
+			if (m_direction > 0 && threads < m_maxThreads)
+			{
+				target = threads + 1;
+			}
+			else if (m_direction < 0 && threads > m_minThreads)
+			{
+				target = threads - 1;
+			}
+			else
+			{
+				// at a bound - the next step tries the other way
+				m_direction = -m_direction;
+			}
+
+			m_lastDecision = target > threads ? ThreadCountDecision::Grow
+				: target < threads ? ThreadCountDecision::Shrink : ThreadCountDecision::Hold;
+			return target;
+		}
+
+		ThreadCountDecision GetLastDecision() const
+		{
+			return m_lastDecision;
+		}
+
+		// the throughput measured at the last step - negative before the first step
+		double GetLastThroughput() const
+		{
+			return m_lastThroughput;
+		}
+
+	private:
+		size_t m_minThreads;
+		size_t m_maxThreads;
+		double m_margin;
+
+		// +1 - adding threads, -1 - removing threads
+		int m_direction = 1;
+		double m_lastThroughput = -1;
+		ThreadCountDecision m_lastDecision = ThreadCountDecision::None;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_HILL_CLIMBING_H
@@ -0,0 +1,227 @@
+/***********************************************************************************************************************
+* @file job.h
+*
+* @brief The internal job type of the Thread Pool - a move only callable wrapper with inline storage.
+*
+* @details	 Internally a job is a void function with no arguments. Before this class the jobs were kept in
+*	std::function<void()>, which has two costs for a thread pool: it must be copyable (so a move only
+*	std::packaged_task has to be wrapped in a std::shared_ptr) and it may allocate for every callable bigger
+*	than a couple of pointers.
+*
+*	Job is move only and keeps every callable up to INLINE_SIZE bytes directly inside the object, so a
+*	typical lambda or a std::packaged_task is stored without touching the heap. Bigger callables (or callables
+*	which may throw when moved) are still accepted - they are allocated on the heap as std::function would do.
+*
+*	The type erasure is done with a small table of function pointers per callable type instead of virtual
+*	functions, so that the object is exactly one cache line - the storage and the table pointer.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_JOB_H
+#define CTP_JOB_H
+
+#include "slab_allocator.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace CTP
+{
+	class Job
+	{
+	public:
+		// the bytes available for a callable stored inline. Together with the table pointer the Job is 64 bytes
+		static const size_t INLINE_SIZE = 64 - sizeof(void*);
+
+		Job()
+			: m_ops(nullptr)
+		{
+		}
+
+		// wraps any callable with signature void() - the callable is moved (or copied) inside
+		template <typename F, typename = typename std::enable_if<
+			!std::is_same<typename std::decay<F>::type, Job>::value>::type>
+		Job(F&& f)
+			: m_ops(nullptr)
+		{
+			typedef typename std::decay<F>::type Callable;
+			Store<Callable>(std::forward<F>(f), std::integral_constant<bool, FitsInline<Callable>::value>());
+		}
+
+		Job(Job&& other) noexcept
+			: m_ops(other.m_ops)
+		{
+			if (m_ops != nullptr)
+			{
+				m_ops->move(&m_storage, &other.m_storage);
+				other.m_ops = nullptr;
+			}
+		}
+
+		Job& operator=(Job&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Reset();
+				if (other.m_ops != nullptr)
+				{
+					other.m_ops->move(&m_storage, &other.m_storage);
+					m_ops = other.m_ops;
+					other.m_ops = nullptr;
+				}
+			}
+			return *this;
+		}
+
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+
+		~Job()
+		{
+			Reset();
+		}
+
+		// executes the callable. Calling an empty job is undefined - check it with operator bool first
+		void operator()()
+		{
+			m_ops->invoke(&m_storage);
+		}
+
+		explicit operator bool() const
+		{
+			return m_ops != nullptr;
+		}
+
+		// a job allocated on its own (the deques of WorkStealing mode hold pointers) comes from the free lists of
+		// slab_allocator.h - exactly one block of 64 bytes, so no job allocates from the system in steady state
+		static void* operator new(size_t size)
+		{
+			return SlabAllocate(size);
+		}
+
+		static void operator delete(void* job, size_t size)
+		{
+			SlabDeallocate(job, size);
+		}
+
+		// declaring the two above hides the placement new - the queues construct jobs in their own storage
+		static void* operator new(size_t, void* place) noexcept
+		{
+			return place;
+		}
+
+		static void operator delete(void*, void*) noexcept
+		{
+		}
+
+		// destroys the stored callable and leaves the job empty
+		void Reset()
+		{
+			if (m_ops != nullptr)
+			{
+				m_ops->destroy(&m_storage);
+				m_ops = nullptr;
+			}
+		}
+
+	private:
+		// the operations of one stored callable type
+		struct Ops
+		{
+			void (*invoke)(void* storage);
+			void (*move)(void* destination, void* source);	// move constructs into destination, destroys source
+			void (*destroy)(void* storage);
+		};
+
+		typedef std::aligned_storage<INLINE_SIZE, std::alignment_of<void*>::value>::type Storage;
+
+		// a callable is kept inline when it fits and cannot throw while being moved between queues
+		template <typename F>
+		struct FitsInline : std::integral_constant<bool,
+			sizeof(F) <= sizeof(Storage) &&
+			std::alignment_of<Storage>::value % std::alignment_of<F>::value == 0 &&
+			std::is_nothrow_move_constructible<F>::value>
+		{
+		};
+
+		// the callable lives inside m_storage
+		template <typename F>
+		struct InlineOps
+		{
+			static void Invoke(void* storage)
+			{
+				(*static_cast<F*>(storage))();
+			}
+			static void Move(void* destination, void* source)
+			{
+				F* from = static_cast<F*>(source);
+				new (destination) F(std::move(*from));
+				from->~F();
+			}
+			static void Destroy(void* storage)
+			{
+				static_cast<F*>(storage)->~F();
+			}
+			static const Ops table;
+		};
+
+		// m_storage keeps only a pointer to the callable on the heap
+		template <typename F>
+		struct HeapOps
+		{
+			static F*& Pointer(void* storage)
+			{
+				return *static_cast<F**>(storage);
+			}
+			static void Invoke(void* storage)
+			{
+				(*Pointer(storage))();
+			}
+			static void Move(void* destination, void* source)
+			{
+				new (destination) F*(Pointer(source));
+			}
+			static void Destroy(void* storage)
+			{
+				delete Pointer(storage);
+			}
+			static const Ops table;
+		};
+
+		template <typename F, typename G>
+		void Store(G&& f, std::true_type /*inline*/)
+		{
+			new (&m_storage) F(std::forward<G>(f));
+			m_ops = &InlineOps<F>::table;
+		}
+
+		template <typename F, typename G>
+		void Store(G&& f, std::false_type /*inline*/)
+		{
+			new (&m_storage) F*(new F(std::forward<G>(f)));
+			m_ops = &HeapOps<F>::table;
+		}
+
+		Storage m_storage;
+		const Ops* m_ops;
+	};
+
+	template <typename F>
+	const Job::Ops Job::InlineOps<F>::table = { &Invoke, &Move, &Destroy };
+
+	template <typename F>
+	const Job::Ops Job::HeapOps<F>::table = { &Invoke, &Move, &Destroy };
+
+} // end of namespace CTP
+
+#endif // CTP_JOB_H
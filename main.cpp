@@ -1,149 +1,1654 @@
-/***********************************************************************************************************************
-* @file main.cpp
-*
-* @brief Test code for the C++11 Thread Pool of Atanas Rusev and Ferai Ali
-*
-* @details	 
-*
-*
-*  The code is based completely on C++11 features. The purpose is to be able to integrate it
-*  in older projects which have not yet reached C++14 or higher. If you need newer features
-*  fork the code and get it to the next level yourself.
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
-*
-***********************************************************************************************************************/
-
-#include <iostream>
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <chrono>
-#include "thread_pool.h"
-
-using namespace std::chrono_literals;
-using namespace std;
-
-void print(std::string text)
-{
-	std::cout << text << std::endl;
-}
-
-
-/***********************************************************************************************************************
-* @brief A function to test the thread pool with longer tasks
-*
-* @details	Based on lambdas we add 3000 jobs that are with default priority and 3000 Critical jobs.
-*		Then we add a sleep for the main thread that will wait until the jobs are executed for sure. 
-*
-* @pre Thread pool creation
-* @post 
-* @param[in]  CTP::ThreadPool &thread_pool
-* @return None
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-*
-***********************************************************************************************************************/
-void run_long_tasks(CTP::ThreadPool &thread_pool)
-{
-	for (int i = 0; i < 3000; i++)
-	{
-		// Schedule a lambda that will first wait 10 milliseconds and then print "Hello World i : ", 
-		// where i is the for cycle index
-		thread_pool.Schedule([i]()
-		{
-			const auto start = std::chrono::system_clock::now();
-			while (start + 10ms > std::chrono::system_clock::now()) {}
-			std::cout << "NORM: " << i << std::endl;			
-		});
-
-		// Schedule a lambda that will first wait 10 milliseconds and then print "First ! i", where
-		// i is the for cycle index
-		thread_pool.Schedule(CTP::Priority::Critical, [i]()
-		{
-			const auto start = std::chrono::system_clock::now();
-			while (start + 10ms > std::chrono::system_clock::now()) {}
-			std::cout << "CRIT: " << i << std::endl;
-		});
-	}
-
-	// simply block the main thread to wait a bit
-	std::this_thread::sleep_for(15s);
-}
-
-/***********************************************************************************************************************
-* @brief A function to test the thread pool with shorter tasks
-*
-* @details	Based on lambdas we add few jobs that are with default priority.
-*		Then we add a sleep for the main thread that will wait until the jobs are executed for sure.
-*
-* @pre Thread pool creation
-* @post
-* @param[in]  CTP::ThreadPool &thread_pool
-* @return None
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-*
-***********************************************************************************************************************/
-void run_small_tasks(CTP::ThreadPool &thread_pool)
-{
-	for (int i = 0; i < 2; i++)
-	{
-		thread_pool.Schedule([i]()
-		{
-			const auto start = std::chrono::system_clock::now();
-			while (start + 2000ms > std::chrono::system_clock::now()) {}
-			std::cout << "MINI: " << i << std::endl;
-		});
-	}
-	std::this_thread::sleep_for(2s);
-}
-
-/***********************************************************************************************************************
-* @brief Main that creates a thread pool and tests it.
-*
-* @details	Tested with default number of threads (the return of std::thread::hardware_concurrency). Tested also 
-* with 1, 4 and 40 threads. Test Machine - HP ZBook 15 G5 with 16 GB RAM and Intel Core i7-8750H Processor.
-* Built initially with Microsoft Visual Studio 2015 as a console application.
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-*
-***********************************************************************************************************************/
-int main()
-{
-	CTP::ThreadPool thread_pool;
-	// CTP::ThreadPool thread_pool(1);
-	// CTP::ThreadPool thread_pool(4);
-	// CTP::ThreadPool thread_pool(40);
-
-	// example with a short lambda from here:
-	auto resultOf34 = thread_pool.Schedule([]()
-	{
-		int i = 3 * 4;
-		print(std::to_string(i));
-		return i;
-	});
-
-	// example for waiting on a future
-	if (resultOf34.wait_for(0ms) == std::future_status::ready)
-	{
-		auto res = resultOf34.get();
-	}
-
-	auto res = resultOf34.get();
-
-	for(int i = 0; i < 2; i++) run_long_tasks(thread_pool);
-	
-	for (int i = 0; i < 2; i++) run_small_tasks(thread_pool);
-	std::this_thread::sleep_for(5s);
-
-	return 0;
-}
+/***********************************************************************************************************************
+* @file main.cpp
+*
+* @brief Test code for the C++11 Thread Pool of Atanas Rusev and Ferai Ali
+*
+* @details	 
+*
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include "cpu_topology.h"
+#include "task_graph.h"
+#include "thread_pool.h"
+#include "worker_local.h"
+
+#include <atomic>
+
+#if defined(CTP_TEST_ZERO_ALLOCATIONS)
+#include <new>
+#endif
+
+using namespace std::chrono_literals;
+using namespace std;
+
+#if defined(CTP_TEST_ZERO_ALLOCATIONS)
+// Test mode for the recycling of the job memory (slab_allocator.h) - build with -DCTP_TEST_ZERO_ALLOCATIONS.
+// Every call of the global operator new - in all its forms - is counted while g_countAllocations is set, on any
+// thread.
+static std::atomic<bool> g_countAllocations(false);
+static std::atomic<size_t> g_allocations(0);
+
+#if defined(__GNUC__)
+#define CTP_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define CTP_NOINLINE __declspec(noinline)
+#else
+#define CTP_NOINLINE
+#endif
+
+// all forms of operator new and delete go through these two. They are not inlined, so that the compiler does not
+// see malloc and free behind operator new and delete and warn about mismatched allocation functions
+CTP_NOINLINE static void* allocate_counted(size_t size)
+{
+	if (g_countAllocations)
+	{
+		g_allocations++;
+	}
+	return std::malloc(size > 0 ? size : 1);
+}
+
+CTP_NOINLINE static void free_counted(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void* operator new(size_t size)
+{
+	if (void* memory = allocate_counted(size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	if (void* memory = allocate_counted(size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate_counted(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate_counted(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free_counted(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free_counted(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free_counted(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free_counted(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free_counted(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free_counted(memory);
+}
+#endif
+
+void print(std::string text)
+{
+	std::cout << text << std::endl;
+}
+
+// the options of a pool for each scheduler mode and queue backend - the demos of the modes run on all of them
+std::vector<CTP::ThreadPoolOptions> all_modes()
+{
+	std::vector<CTP::ThreadPoolOptions> modes;
+	for (CTP::SchedulerMode scheduler : { CTP::SchedulerMode::SharedQueue, CTP::SchedulerMode::WorkStealing })
+	{
+		for (CTP::QueueBackend backend : { CTP::QueueBackend::Locked, CTP::QueueBackend::LockFreeRing })
+		{
+			CTP::ThreadPoolOptions options;
+			options.schedulerMode = scheduler;
+			options.queueBackend = backend;
+			modes.push_back(options);
+		}
+	}
+	return modes;
+}
+
+std::string mode_name(const CTP::ThreadPoolOptions& options)
+{
+	std::string name = CTP::SchedulerMode::WorkStealing == options.schedulerMode ? "WorkStealing" : "SharedQueue";
+	name += CTP::QueueBackend::LockFreeRing == options.queueBackend ? " + LockFreeRing" : " + Locked";
+	return name;
+}
+
+// stops the test if a result is wrong - unlike assert also in a release build. The text is a plain C string, so
+// that a check allocates nothing (see run_zero_allocations)
+void check(bool condition, const char* text)
+{
+	if (!condition)
+	{
+		std::cerr << "FAILED: " << text << std::endl;
+		std::abort();
+	}
+}
+
+
+/***********************************************************************************************************************
+* @brief A function to test the thread pool with longer tasks
+*
+* @details	Based on lambdas we add 3000 jobs that are with default priority and 3000 Critical jobs.
+*		Then we add a sleep for the main thread that will wait until the jobs are executed for sure. 
+*
+* @pre Thread pool creation
+* @post 
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_long_tasks(CTP::ThreadPool &thread_pool)
+{
+	for (int i = 0; i < 3000; i++)
+	{
+		// Schedule a lambda that will first wait 10 milliseconds and then print "Hello World i : ", 
+		// where i is the for cycle index
+		thread_pool.Schedule([i]()
+		{
+			const auto start = std::chrono::system_clock::now();
+			while (start + 10ms > std::chrono::system_clock::now()) {}
+			std::cout << "NORM: " << i << std::endl;			
+		});
+
+		// Schedule a lambda that will first wait 10 milliseconds and then print "First ! i", where
+		// i is the for cycle index
+		thread_pool.Schedule(CTP::Priority::Critical, [i]()
+		{
+			const auto start = std::chrono::system_clock::now();
+			while (start + 10ms > std::chrono::system_clock::now()) {}
+			std::cout << "CRIT: " << i << std::endl;
+		});
+	}
+
+	// simply block the main thread to wait a bit
+	std::this_thread::sleep_for(15s);
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the thread pool with shorter tasks
+*
+* @details	Based on lambdas we add few jobs that are with default priority.
+*		Then we add a sleep for the main thread that will wait until the jobs are executed for sure.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_small_tasks(CTP::ThreadPool &thread_pool)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		thread_pool.Schedule([i]()
+		{
+			const auto start = std::chrono::system_clock::now();
+			while (start + 2000ms > std::chrono::system_clock::now()) {}
+			std::cout << "MINI: " << i << std::endl;
+		});
+	}
+	std::this_thread::sleep_for(2s);
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the parallel loop of the thread pool
+*
+* @details	Instead of scheduling one job per index as in run_long_tasks, the loop is split in chunks by the pool.
+*		The main thread processes chunks as well and returns once all indexes are done - no sleep is needed.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_parallel_for(CTP::ThreadPool &thread_pool)
+{
+	std::vector<int> squares(3000);
+	thread_pool.ParallelFor(size_t(0), squares.size(), [&squares](size_t i)
+	{
+		squares[i] = static_cast<int>(i * i);
+	});
+	std::cout << "PFOR: " << squares.back() << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test waiting for a result inside a job
+*
+* @details	The outer job schedules an inner job and waits for it. With future.get() this deadlocks in a pool with
+*		a single thread - the only thread sleeps while the inner job is queued. thread_pool.Get executes the
+*		inner job on the waiting thread instead.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_nested_wait(CTP::ThreadPool &thread_pool)
+{
+	auto outer = thread_pool.Schedule([&thread_pool]()
+	{
+		auto inner = thread_pool.Schedule([]() { return 7 * 6; });
+		return thread_pool.Get(inner);
+	});
+	std::cout << "NEST: " << outer.get() << std::endl;
+}
+
+// the n-th Fibonacci number with one job per call - each job schedules its two sub jobs and waits for them
+int fibonacci(CTP::ThreadPool &thread_pool, int n)
+{
+	if (n < 2)
+	{
+		return n;
+	}
+	auto first = thread_pool.Schedule([&thread_pool, n]() { return fibonacci(thread_pool, n - 1); });
+	const int second = fibonacci(thread_pool, n - 2);
+	return thread_pool.Get(first) + second;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test jobs which schedule jobs themselves
+*
+* @details	A recursive Fibonacci with one job per call. In WorkStealing mode the jobs a thread schedules go to its
+*		own deque and the idle threads steal them - the number of steals is printed. In SharedQueue mode all jobs go
+*		through the shared queues and nothing is stolen.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_work_stealing(CTP::ThreadPool &thread_pool)
+{
+	auto result = thread_pool.Schedule([&thread_pool]() { return fibonacci(thread_pool, 16); });
+	const int value = result.get();
+	check(987 == value, "the recursive jobs computed a wrong value");
+
+	const CTP::ThreadPoolStats stats = thread_pool.GetStats();
+	uint64_t steals = 0;
+	for (uint64_t count : stats.steals)
+	{
+		steals += count;
+	}
+	std::cout << "STEAL: fib(16) = " << value << ", " << stats.jobsExecuted << " jobs, " << steals << " stolen"
+		<< std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the lock free ring backend when the rings are full
+*
+* @details	A pool with rings of only 16 jobs per priority. The first job holds the threads back until 1000 more
+*		jobs are added, so most of them do not fit into the ring and go to the locked overflow queue. All of them
+*		must be executed nevertheless - with both scheduler modes.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_lock_free_ring()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		if (CTP::QueueBackend::LockFreeRing != options.queueBackend)
+		{
+			continue;
+		}
+		options.ringCapacity = 16;
+		options.threadCount = 2;
+		CTP::ThreadPool ring_pool(options);
+
+		std::atomic<bool> open(false);
+		ring_pool.Post([&open]()
+		{
+			while (!open)
+			{
+				std::this_thread::yield();
+			}
+		});
+
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 1000; i++)
+		{
+			results.push_back(ring_pool.Schedule([i]() { return i; }));
+		}
+		open = true;
+
+		int sum = 0;
+		for (auto& result : results)
+		{
+			sum += result.get();
+		}
+		check(999 * 1000 / 2 == sum, "a job of the full ring was lost");
+		std::cout << "RING: " << mode_name(options) << ", capacity " << options.ringCapacity << ", sum " << sum
+			<< std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the order of the jobs which do not fit in the ring
+*
+* @details	A pool with one thread and a ring of 2 jobs. Job 0 holds the thread while jobs 1 to 10 are posted - 2 of
+*		them fit in the ring, 8 go to the overflow queue. Then job 1 holds the thread, after it took a cell of the
+*		ring free, while 5000 more jobs are posted. The later jobs must queue up behind the overflowed ones and
+*		not overtake them through the free cell - each job records its number and the numbers must come in the
+*		order of posting.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_ring_overflow_order()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		if (CTP::QueueBackend::LockFreeRing != options.queueBackend)
+		{
+			continue;
+		}
+		options.ringCapacity = 2;
+		options.threadCount = 1;
+		CTP::ThreadPool ring_pool(options);
+
+		const int jobCount = 5011;
+		std::vector<int> order;
+		order.reserve(jobCount);
+		std::atomic<int> done(0);
+		std::atomic<int> holding(-1);
+		std::atomic<int> released(-1);
+
+		// only the single thread of the pool writes to order. Jobs 0 and 1 hold the thread until released
+		auto post = [&](int i)
+		{
+			ring_pool.Post([i, &order, &done, &holding, &released]()
+			{
+				order.push_back(i);
+				if (i < 2)
+				{
+					holding = i;
+					while (released < i)
+					{
+						std::this_thread::yield();
+					}
+				}
+				done++;
+			});
+		};
+		auto wait_holding = [&holding](int i)
+		{
+			while (holding < i)
+			{
+				std::this_thread::yield();
+			}
+		};
+
+		post(0);
+		wait_holding(0);
+		for (int i = 1; i <= 10; i++)
+		{
+			post(i);
+		}
+		released = 0;
+		wait_holding(1);
+		for (int i = 11; i < jobCount; i++)
+		{
+			post(i);
+			if (11 == i)
+			{
+				released = 1;
+			}
+		}
+		while (done < jobCount)
+		{
+			std::this_thread::yield();
+		}
+
+		check(std::is_sorted(order.begin(), order.end()), "a job of the overflow queue was overtaken by later jobs");
+		std::cout << "RING OVERFLOW: " << mode_name(options) << ", " << order.size() << " jobs in order" << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test adding many jobs at once
+*
+* @details	ScheduleBatch adds 100 jobs with one lock of the queue (or one reservation in the ring) and returns their
+*		futures. PostBatch adds 100 fire and forget jobs the same way - the main thread waits until their counter
+*		is complete.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_batches(CTP::ThreadPool &thread_pool)
+{
+	std::vector<std::function<int()>> jobs;
+	for (int i = 0; i < 100; i++)
+	{
+		jobs.push_back([i]() { return i * i; });
+	}
+	auto results = thread_pool.ScheduleBatch(CTP::Priority::High, jobs.begin(), jobs.end());
+	int sum = 0;
+	for (auto& result : results)
+	{
+		sum += result.get();
+	}
+	check(328350 == sum, "ScheduleBatch returned wrong values");
+
+	std::atomic<int> posted(0);
+	std::vector<std::function<void()>> fire_and_forget(100, [&posted]() { posted++; });
+	thread_pool.PostBatch(fire_and_forget.begin(), fire_and_forget.end());
+	while (posted < 100)
+	{
+		std::this_thread::yield();
+	}
+
+	std::cout << "BATCH: " << results.size() << " scheduled, sum " << sum << ", " << posted << " posted" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the parallel reductions
+*
+* @details	ParallelReduce sums the numbers 1 to 10000 and ParallelTransformReduce finds the longest of some strings.
+*		Both results are known in advance and checked.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_parallel_reduce(CTP::ThreadPool &thread_pool)
+{
+	std::vector<long long> numbers(10000);
+	for (size_t i = 0; i < numbers.size(); i++)
+	{
+		numbers[i] = static_cast<long long>(i + 1);
+	}
+	const long long sum = thread_pool.ParallelReduce(numbers.begin(), numbers.end(), 0LL,
+		[](long long left, long long right) { return left + right; });
+	check(50005000LL == sum, "ParallelReduce returned a wrong sum");
+
+	std::vector<std::string> words(1000, "job");
+	words[700] = "continuation";
+	const size_t longest = thread_pool.ParallelTransformReduce(words.begin(), words.end(), size_t(0),
+		[](size_t left, size_t right) { return std::max(left, right); },
+		[](const std::string& word) { return word.size(); });
+	check(12 == longest, "ParallelTransformReduce returned a wrong maximum");
+
+	std::cout << "REDUCE: sum " << sum << ", longest " << longest << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the task graph
+*
+* @details	A diamond of four nodes - load, two transforms depending on it and a store depending on both. The graph
+*		is built once and run three times, each run must see the transforms after the load and the store last.
+*		A second graph with a throwing node must deliver the exception through its future and skip its successor.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_task_graph(CTP::ThreadPool &thread_pool)
+{
+	int loaded = 0;
+	int doubled = 0;
+	int squared = 0;
+	int stored = 0;
+
+	CTP::TaskGraph graph;
+	auto load = graph.AddNode([&loaded]() { loaded++; });
+	auto twice = graph.AddNode([&loaded, &doubled]() { doubled = loaded * 2; });
+	auto square = graph.AddNode([&loaded, &squared]() { squared = loaded * loaded; }, CTP::Priority::High);
+	auto store = graph.AddNode([&doubled, &squared, &stored]() { stored = doubled + squared; });
+	graph.AddEdge(load, twice);
+	graph.AddEdge(load, square);
+	graph.AddEdge(twice, store);
+	graph.AddEdge(square, store);
+
+	for (int run = 0; run < 3; run++)
+	{
+		graph.Run(thread_pool).get();
+	}
+	check(3 == loaded && 15 == stored, "the nodes of the graph ran in a wrong order");
+
+	bool skipped = true;
+	CTP::TaskGraph failing;
+	auto thrower = failing.AddNode([]() { throw std::runtime_error("node failed"); });
+	auto successor = failing.AddNode([&skipped]() { skipped = false; });
+	failing.AddEdge(thrower, successor);
+	std::string error;
+	try
+	{
+		failing.Run(thread_pool).get();
+	}
+	catch (const std::runtime_error& e)
+	{
+		error = e.what();
+	}
+	check("node failed" == error && skipped, "the exception of a node was not delivered");
+
+	std::cout << "GRAPH: " << graph.GetNodeCount() << " nodes, 3 runs, stored " << stored << ", error '" << error
+		<< "'" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the continuations of CTP::Future
+*
+* @details	A chain of Then continuations runs without any thread waiting in between. WhenAll collects the values of
+*		ten jobs, WhenAny reports the first of a fast and a slow job, and an exception thrown by a job skips the
+*		continuation and arrives at the end of the chain.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_continuations(CTP::ThreadPool &thread_pool)
+{
+	auto chain = thread_pool.ScheduleAsync([]() { return 20; })
+		.Then([](int value) { return value + 1; })
+		.Then(CTP::Priority::High, [](int value) { return value * 2; });
+	const int chained = chain.Get();
+	check(42 == chained, "the chain of Then returned a wrong value");
+
+	std::vector<CTP::Future<int>> parts;
+	for (int i = 1; i <= 10; i++)
+	{
+		parts.push_back(thread_pool.ScheduleAsync([i]() { return i; }));
+	}
+	const std::vector<int> all = CTP::WhenAll(std::move(parts)).Get();
+	int sum = 0;
+	for (int value : all)
+	{
+		sum += value;
+	}
+	check(10 == all.size() && 55 == sum, "WhenAll returned wrong values");
+
+	std::vector<CTP::Future<int>> racers;
+	racers.push_back(thread_pool.ScheduleAsync(CTP::Priority::High, []() { return 1; }));
+	racers.push_back(thread_pool.ScheduleAsync([]()
+	{
+		std::this_thread::sleep_for(50ms);
+		return 2;
+	}));
+	CTP::WhenAnyResult<int> any = CTP::WhenAny(std::move(racers)).Get();
+	check(any.futures[any.index].IsReady(), "WhenAny reported a future which is not ready");
+	const int first = any.futures[any.index].Get();
+
+	std::string error;
+	try
+	{
+		thread_pool.ScheduleAsync([]() -> int { throw std::runtime_error("job failed"); })
+			.Then([](int value) { return value + 1; })
+			.Get();
+	}
+	catch (const std::runtime_error& e)
+	{
+		error = e.what();
+	}
+	check("job failed" == error, "the exception was not passed along the chain");
+
+	std::cout << "THEN: chain " << chained << ", all " << sum << ", first " << first << " (index " << any.index
+		<< "), error '" << error << "'" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the spinning idle policy
+*
+* @details	Pools with IdlePolicy::SpinThenPark get bursts of short jobs with short gaps in between - the load the
+*		policy is made for. The threads spin through the gaps instead of sleeping. All jobs must be executed, with
+*		each scheduler mode and queue backend.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_spin_idle()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		options.idlePolicy = CTP::IdlePolicy::SpinThenPark;
+		options.maxSpinTime = std::chrono::microseconds(100);
+		CTP::ThreadPool spin_pool(options);
+
+		int sum = 0;
+		for (int burst = 0; burst < 20; burst++)
+		{
+			std::vector<std::future<int>> results;
+			for (int i = 0; i < 50; i++)
+			{
+				results.push_back(spin_pool.Schedule([i]() { return i; }));
+			}
+			for (auto& result : results)
+			{
+				sum += result.get();
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+		check(20 * 1225 == sum, "a job was lost between the bursts");
+		std::cout << "SPIN: " << mode_name(options) << ", sum " << sum << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test waking up the sleeping threads
+*
+* @details	Each job is added only after the threads have gone to sleep, so every job needs a wake up. None may be
+*		lost - a job not started within a second counts as lost. Then two threads add jobs at the same time while
+*		the threads of the pool fall asleep and wake up again.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_wakeups(CTP::ThreadPool &thread_pool)
+{
+	for (int i = 0; i < 20; i++)
+	{
+		std::this_thread::sleep_for(2ms);
+		auto result = thread_pool.Schedule([i]() { return i; });
+		check(std::future_status::ready == result.wait_for(1s), "a sleeping thread was not woken up");
+	}
+
+	std::atomic<int> executed(0);
+	auto add_jobs = [&thread_pool, &executed]()
+	{
+		for (int i = 0; i < 100; i++)
+		{
+			thread_pool.Post([&executed]() { executed++; });
+			if (0 == i % 10)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		}
+	};
+	std::thread first(add_jobs);
+	std::thread second(add_jobs);
+	first.join();
+	second.join();
+
+	const auto deadline = std::chrono::steady_clock::now() + 5s;
+	while (executed < 200 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+	check(200 == executed, "a job added from another thread was not executed");
+
+	std::cout << "WAKE: 20 single jobs, " << executed << " jobs from two threads" << std::endl;
+}
+
+// the CPUs as text, e.g. "0 1 2 3" - "-" for a thread which is not pinned
+std::string cpu_list(const std::vector<int>& cpus)
+{
+	std::string text;
+	for (int cpu : cpus)
+	{
+		text += (text.empty() ? "" : " ") + (CTP::NO_CPU == cpu ? std::string("-") : std::to_string(cpu));
+	}
+	return text;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test pinning the threads to CPUs
+*
+* @details	Pools with one thread per available CPU, pinned Compact and Scatter. Each thread must be pinned to a CPU
+*		the process may use, and as there are as many threads as CPUs no CPU may get two threads. On a system
+*		without pinning support the threads stay unpinned.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_affinity()
+{
+	const std::vector<int> available = CTP::GetAvailableCpus();
+	for (const CTP::AffinityPolicy& policy : { CTP::AffinityPolicy::Compact(), CTP::AffinityPolicy::Scatter() })
+	{
+		CTP::ThreadPoolOptions options;
+		options.threadCount = available.empty() ? 2 : available.size();
+		options.affinity = policy;
+		CTP::ThreadPool pinned_pool(options);
+
+		std::vector<int> cpus = pinned_pool.GetWorkerCpus();
+		std::vector<int> used;
+		for (int cpu : cpus)
+		{
+			if (CTP::NO_CPU == cpu)
+			{
+				continue;
+			}
+			check(std::find(available.begin(), available.end(), cpu) != available.end(),
+				"a thread was pinned to a CPU the process may not use");
+			check(std::find(used.begin(), used.end(), cpu) == used.end(), "two threads were pinned to the same CPU");
+			used.push_back(cpu);
+		}
+
+		std::cout << "PIN: " << (CTP::AffinityMode::Compact == policy.mode ? "Compact" : "Scatter") << ", CPUs "
+			<< cpu_list(cpus) << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the thread count presets
+*
+* @details	Prints the CPU topology the presets are based on and creates a pool of each preset. No preset may have
+*		more threads than the default thread count, PhysicalCoresOnly has at most one thread per physical core and
+*		OneThreadPerL3 at most one per L3 domain - where the topology is known. Each pool must execute a job.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_presets()
+{
+	const CTP::CpuTopology topology = CTP::CpuTopology::Discover();
+	std::cout << "TOPO: " << topology.GetLogicalCpuCount() << " CPUs, " << topology.GetPhysicalCoreCount()
+		<< " cores, " << topology.GetL3Count() << " L3 domains, " << topology.GetSocketCount() << " sockets, "
+		<< topology.GetNodeCount() << " NUMA nodes" << std::endl;
+
+	const size_t default_count = CTP::GetDefaultThreadCount().count;
+	const CTP::ThreadCountPreset presets[] = { CTP::ThreadCountPreset::HardwareConcurrency,
+		CTP::ThreadCountPreset::PhysicalCoresOnly, CTP::ThreadCountPreset::OneThreadPerL3 };
+	const char* names[] = { "HardwareConcurrency", "PhysicalCoresOnly", "OneThreadPerL3" };
+	for (size_t i = 0; i < 3; i++)
+	{
+		CTP::ThreadPool preset_pool(presets[i]);
+		const size_t threads = preset_pool.GetThreadCount();
+		check(threads >= 1 && threads <= default_count, "a preset has more threads than the default count");
+		if (topology.GetPhysicalCoreCount() > 0 && CTP::ThreadCountPreset::PhysicalCoresOnly == presets[i])
+		{
+			check(threads <= topology.GetPhysicalCoreCount(), "PhysicalCoresOnly has more threads than cores");
+		}
+		if (topology.GetL3Count() > 0 && CTP::ThreadCountPreset::OneThreadPerL3 == presets[i])
+		{
+			check(threads <= topology.GetL3Count(), "OneThreadPerL3 has more threads than L3 domains");
+		}
+
+		auto result = preset_pool.Schedule([]() { return 1; });
+		check(1 == result.get(), "the pool of a preset did not execute a job");
+		std::cout << "PRESET: " << names[i] << ", " << threads << " threads, CPUs "
+			<< cpu_list(preset_pool.GetWorkerCpus()) << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the default thread count
+*
+* @details	Prints the default thread count and the limit it comes from - hardware_concurrency, the affinity mask or
+*		the cgroup CPU quota. A pool created without a thread count (0) must get exactly this many threads, an
+*		explicit thread count is taken as it is.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_default_thread_count()
+{
+	const CTP::DefaultThreadCount default_count = CTP::GetDefaultThreadCount();
+	std::cout << "COUNT: " << default_count.count << " threads - " << default_count.reason << std::endl;
+
+	CTP::ThreadPool default_pool;
+	check(default_count.count == default_pool.GetThreadCount(), "the default pool has a wrong thread count");
+
+	CTP::ThreadPoolOptions options;
+	options.threadCount = 3;
+	CTP::ThreadPool explicit_pool(options);
+	check(3 == explicit_pool.GetThreadCount(), "an explicit thread count was not taken");
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the NUMA partitioned pool
+*
+* @details	A NUMA partitioned pool of each scheduler mode and queue backend. Every thread must belong to one of the
+*		nodes, and jobs added to each node with ScheduleOnNode and PostOnNode must all be executed. On a machine
+*		with one NUMA node the pool has one node - the same as a pool without NUMA mode.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_numa()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		options.numaPartitioned = true;
+		CTP::ThreadPool numa_pool(options);
+
+		const size_t nodes = numa_pool.GetNodeCount();
+		std::string worker_nodes;
+		for (size_t node : numa_pool.GetWorkerNodes())
+		{
+			check(node < nodes, "a thread belongs to an unknown node");
+			worker_nodes += (worker_nodes.empty() ? "" : " ") + std::to_string(node);
+		}
+
+		std::atomic<int> posted(0);
+		std::vector<std::future<size_t>> results;
+		for (size_t node = 0; node < nodes; node++)
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				results.push_back(numa_pool.ScheduleOnNode(node, [node]() { return node; }));
+				numa_pool.PostOnNode(node, [&posted]() { posted++; });
+			}
+		}
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			check(i / 10 == results[i].get(), "a job of a node returned a wrong value");
+		}
+		while (posted < static_cast<int>(10 * nodes))
+		{
+			std::this_thread::yield();
+		}
+
+		std::cout << "NUMA: " << mode_name(options) << ", " << nodes << " nodes, thread nodes " << worker_nodes
+			<< std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the steal order of the WorkStealing mode
+*
+* @details	WorkStealing pools with all threads pinned Compact compute the recursive Fibonacci. An idle thread steals
+*		from its SMT sibling first, then within its L3 domain, its socket and only then from other sockets - the
+*		steals are printed by distance. With all threads pinned on a known topology no distance may be unknown.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_steal_order()
+{
+	const std::vector<int> available = CTP::GetAvailableCpus();
+	const bool topology_known = !CTP::CpuTopology::Discover().IsEmpty();
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		if (CTP::SchedulerMode::WorkStealing != options.schedulerMode)
+		{
+			continue;
+		}
+		options.threadCount = available.empty() ? 2 : available.size();
+		options.affinity = CTP::AffinityPolicy::Compact();
+		CTP::ThreadPool stealing_pool(options);
+
+		auto result = stealing_pool.Schedule([&stealing_pool]() { return fibonacci(stealing_pool, 16); });
+		check(987 == result.get(), "the recursive jobs computed a wrong value");
+
+		const std::vector<int> cpus = stealing_pool.GetWorkerCpus();
+		const bool all_pinned = std::find(cpus.begin(), cpus.end(), CTP::NO_CPU) == cpus.end();
+		const CTP::ThreadPoolStats stats = stealing_pool.GetStats();
+		const size_t unknown = static_cast<size_t>(CTP::StealDistance::Unknown);
+		check(!(topology_known && all_pinned) || 0 == stats.steals[unknown], "a steal has an unknown distance");
+
+		std::cout << "ORDER: " << mode_name(options) << ", steals core/L3/socket/remote/unknown "
+			<< stats.steals[0] << "/" << stats.steals[1] << "/" << stats.steals[2] << "/" << stats.steals[3] << "/"
+			<< stats.steals[4] << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the elastic pool
+*
+* @details	Elastic pools of 1 to 4 threads get 20 jobs which block for 10 ms each. The jobs wait, so the pool must
+*		add threads. Once all jobs are done the added threads find no more jobs and must retire again after the
+*		keep alive time, down to the one thread the pool started with.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_elastic()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		options.threadCount = 1;
+		options.maxThreadCount = 4;
+		options.growDelay = 2ms;
+		options.keepAlive = 50ms;
+		CTP::ThreadPool elastic_pool(options);
+
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 20; i++)
+		{
+			results.push_back(elastic_pool.Schedule([i]()
+			{
+				std::this_thread::sleep_for(10ms);
+				return i;
+			}));
+		}
+		int sum = 0;
+		for (auto& result : results)
+		{
+			sum += result.get();
+		}
+		check(190 == sum, "the elastic pool returned wrong values");
+		const size_t busy_threads = elastic_pool.GetThreadCount();
+
+		const auto deadline = std::chrono::steady_clock::now() + 5s;
+		while (elastic_pool.GetThreadCount() > 1 && std::chrono::steady_clock::now() < deadline)
+		{
+			std::this_thread::sleep_for(10ms);
+		}
+		const CTP::ThreadPoolStats stats = elastic_pool.GetStats();
+		check(stats.threadsAdded > 0, "the elastic pool added no thread for the waiting jobs");
+		check(1 == elastic_pool.GetThreadCount(), "the idle threads did not retire");
+
+		std::cout << "ELASTIC: " << mode_name(options) << ", " << busy_threads << " threads when busy, "
+			<< stats.threadsAdded << " added, " << stats.threadsRetired << " retired" << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the thread count tuning by hill climbing
+*
+* @details	An elastic pool of 1 to 4 threads with hill climbing gets a steady stream of jobs which block for 1 ms
+*		for about 300 ms - long enough for several tuning steps. The target thread count must stay within the
+*		bounds, and the controller must have measured a throughput. The last decision is printed.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_hill_climbing()
+{
+	CTP::ThreadPoolOptions options;
+	options.threadCount = 1;
+	options.maxThreadCount = 4;
+	options.hillClimbing = true;
+	options.tuningInterval = 20ms;
+	CTP::ThreadPool tuned_pool(options);
+
+	std::atomic<int> executed(0);
+	const auto end = std::chrono::steady_clock::now() + 300ms;
+	while (std::chrono::steady_clock::now() < end)
+	{
+		std::vector<std::future<void>> results;
+		for (int i = 0; i < 8; i++)
+		{
+			results.push_back(tuned_pool.Schedule([&executed]()
+			{
+				std::this_thread::sleep_for(1ms);
+				executed++;
+			}));
+		}
+		for (auto& result : results)
+		{
+			result.get();
+		}
+	}
+
+	const CTP::ThreadPoolStats stats = tuned_pool.GetStats();
+	check(stats.targetThreadCount >= 1 && stats.targetThreadCount <= 4, "the target thread count is out of bounds");
+	check(stats.throughput > 0, "the controller measured no throughput");
+
+	const char* decisions[] = { "None", "Hold", "Grow", "Shrink" };
+	std::cout << "TUNE: " << executed << " jobs, target " << stats.targetThreadCount << " threads, "
+		<< stats.throughput << " jobs/s, last decision " << decisions[static_cast<size_t>(stats.lastDecision)]
+		<< ", " << stats.threadCountChanges << " changes" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the lazy start of the threads
+*
+* @details	Lazy pools of 4 threads start no thread in the constructor. The first job starts one, Prewarm starts the
+*		rest. GetThreadCount counts the threads not started yet as well, GetStats only the running ones.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_lazy_start()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		options.threadCount = 4;
+		options.lazyStart = true;
+		CTP::ThreadPool lazy_pool(options);
+		check(0 == lazy_pool.GetStats().threadCount, "the lazy pool started a thread in its constructor");
+		check(4 == lazy_pool.GetThreadCount(), "the lazy pool does not count its threads");
+
+		auto result = lazy_pool.Schedule([]() { return 5; });
+		check(5 == result.get(), "the first job of the lazy pool returned a wrong value");
+		const size_t after_first_job = lazy_pool.GetStats().threadCount;
+		check(after_first_job >= 1, "the first job did not start a thread");
+
+		lazy_pool.Prewarm();
+		check(4 == lazy_pool.GetStats().threadCount, "Prewarm did not start all threads");
+
+		std::cout << "LAZY: " << mode_name(options) << ", " << after_first_job << " after the first job, "
+			<< lazy_pool.GetStats().threadCount << " after Prewarm" << std::endl;
+	}
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the stack size of the threads
+*
+* @details	A pool with a stack of 256 KB and a guard area of 64 KB per thread. The threads must have got at least
+*		the requested stack, and a job using 64 KB of its stack must run. On a system which does not report the
+*		stack the sizes are 0 and only the job is checked.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_stack_size()
+{
+	CTP::ThreadPoolOptions options;
+	options.threadCount = 2;
+	options.stackSize = 256 * 1024;
+	options.guardSize = 64 * 1024;
+	CTP::ThreadPool small_stack_pool(options);
+
+	auto result = small_stack_pool.Schedule([]()
+	{
+		volatile char buffer[64 * 1024];
+		for (size_t i = 0; i < sizeof(buffer); i++)
+		{
+			buffer[i] = static_cast<char>(i);
+		}
+		return static_cast<int>(buffer[100]);
+	});
+	check(100 == result.get(), "the job on the small stack returned a wrong value");
+
+	for (const CTP::WorkerStack& stack : small_stack_pool.GetWorkerStacks())
+	{
+		check(0 == stack.stackSize || stack.stackSize >= options.stackSize, "a thread got a smaller stack");
+		std::cout << "STACK: " << stack.stackSize / 1024 << " KB stack, " << stack.guardSize / 1024 << " KB guard"
+			<< std::endl;
+	}
+}
+
+// set by the onWorkerStart hook - the per thread initialization a job may rely on
+static thread_local size_t t_hook_index = CTP::NO_WORKER;
+
+/***********************************************************************************************************************
+* @brief A function to test the start and stop hooks of the threads
+*
+* @details	The start hook stores the index of the thread in a thread_local variable, which every job must then find
+*		initialized with the index of the thread running it. Once the pool is destroyed each thread must have
+*		called both hooks exactly once.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_worker_hooks()
+{
+	std::atomic<int> started(0);
+	std::atomic<int> stopped(0);
+	{
+		CTP::ThreadPoolOptions options;
+		options.threadCount = 3;
+		options.onWorkerStart = [&started](size_t index)
+		{
+			t_hook_index = index;
+			started++;
+		};
+		options.onWorkerStop = [&stopped](size_t)
+		{
+			t_hook_index = CTP::NO_WORKER;
+			stopped++;
+		};
+		CTP::ThreadPool hooked_pool(options);
+
+		std::vector<std::future<bool>> results;
+		for (int i = 0; i < 30; i++)
+		{
+			results.push_back(hooked_pool.Schedule([&hooked_pool]()
+			{
+				return t_hook_index == hooked_pool.GetWorkerIndex();
+			}));
+		}
+		for (auto& result : results)
+		{
+			check(result.get(), "a job ran on a thread which was not initialized by the start hook");
+		}
+	}
+	check(3 == started && 3 == stopped, "the hooks were not called once per thread");
+
+	std::cout << "HOOKS: " << started << " started, " << stopped << " stopped" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the per thread values of WorkerLocal
+*
+* @details	A parallel loop counts the even numbers below 100000 and sums them up - each thread in its own instance,
+*		without any lock or atomic operation. Combine merges the instances afterwards. The instance of the threads
+*		outside of the pool is refused to a second such thread while the main thread holds it.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_worker_local(CTP::ThreadPool &thread_pool)
+{
+	struct Tally
+	{
+		long long count;
+		long long sum;
+	};
+
+	CTP::WorkerLocal<Tally> tallies(thread_pool, Tally{ 0, 0 });
+	thread_pool.ParallelFor(size_t(0), size_t(100000), [&tallies](size_t i)
+	{
+		if (0 == i % 2)
+		{
+			Tally& tally = tallies.Local();
+			tally.count++;
+			tally.sum += static_cast<long long>(i);
+		}
+	});
+
+	const Tally total = tallies.Combine(Tally{ 0, 0 }, [](Tally left, const Tally& right)
+	{
+		return Tally{ left.count + right.count, left.sum + right.sum };
+	});
+	check(50000 == total.count && 2499950000LL == total.sum, "the per thread values were merged wrong");
+
+	// the main thread holds the instance of the threads outside of the pool until the next Combine - another
+	// thread outside of the pool must not get it meanwhile
+	tallies.Local().count++;
+	bool refused = false;
+	std::thread outsider([&tallies, &refused]()
+	{
+		try
+		{
+			tallies.Local().count++;
+		}
+		catch (const std::logic_error&)
+		{
+			refused = true;
+		}
+	});
+	outsider.join();
+	check(refused, "two threads outside of the pool got the same instance");
+
+	std::cout << "LOCAL: " << tallies.Size() << " instances, " << total.count << " even numbers, sum "
+		<< total.sum << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the scratch arenas of the threads
+*
+* @details	Each job sorts a temporary buffer of 1000 numbers allocated from the scratch arena of its thread. A job
+*		must find the arena of its thread empty - everything the previous jobs allocated was freed when they
+*		returned. The main thread has no arena.
+*
+* @pre Thread pool creation
+* @post
+* @param[in]  CTP::ThreadPool &thread_pool
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_scratch_arena(CTP::ThreadPool &thread_pool)
+{
+	check(nullptr == thread_pool.GetScratchArena(), "the main thread has a scratch arena");
+
+	std::vector<std::future<int>> results;
+	for (int i = 0; i < 100; i++)
+	{
+		results.push_back(thread_pool.Schedule([&thread_pool, i]()
+		{
+			CTP::ScratchArena* arena = thread_pool.GetScratchArena();
+			const CTP::ScratchArena::Marker start = arena->GetMarker();
+			if (0 != start.chunk || 0 != start.used)
+			{
+				return -1;
+			}
+
+			CTP::ArenaAllocator<int> allocator(*arena);
+			std::vector<int, CTP::ArenaAllocator<int>> buffer(allocator);
+			for (int value = 0; value < 1000; value++)
+			{
+				buffer.push_back((value * 7919 + i) % 1000);
+			}
+			std::sort(buffer.begin(), buffer.end());
+			return buffer.back();
+		}));
+	}
+	for (auto& result : results)
+	{
+		check(999 == result.get(), "a job found memory of a previous job in its arena");
+	}
+
+	std::cout << "ARENA: " << results.size() << " jobs sorted their buffers in the scratch arenas" << std::endl;
+}
+
+/***********************************************************************************************************************
+* @brief A function to test the exception handler of the pool
+*
+* @details	The jobs added with Post and PostBatch have no future to carry an exception. A pool with an
+*		exceptionHandler in its options receives what they throw there - 10 posted jobs and a batch of 5 jobs
+*		throw, and the handler counts the std::runtime_error it receives.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_exception_handler()
+{
+	std::atomic<int> handled(0);
+	std::atomic<int> unexpected(0);
+
+	CTP::ThreadPoolOptions options;
+	options.threadCount = 2;
+	options.exceptionHandler = [&handled, &unexpected](std::exception_ptr exception)
+	{
+		try
+		{
+			std::rethrow_exception(exception);
+		}
+		catch (const std::runtime_error&)
+		{
+			handled++;
+		}
+		catch (...)
+		{
+			unexpected++;
+		}
+	};
+	CTP::ThreadPool handler_pool(options);
+
+	for (int i = 0; i < 10; i++)
+	{
+		handler_pool.Post([]() { throw std::runtime_error("posted job failed"); });
+	}
+	auto failing = []() { throw std::runtime_error("batch job failed"); };
+	const std::vector<decltype(failing)> batch(5, failing);
+	handler_pool.PostBatch(batch.begin(), batch.end());
+
+	while (handled + unexpected < 15)
+	{
+		std::this_thread::yield();
+	}
+	check(15 == handled && 0 == unexpected, "the exception handler missed an exception");
+	std::cout << "HANDLER: " << handled << " exceptions of posted jobs handled" << std::endl;
+}
+
+#if defined(CTP_TEST_ZERO_ALLOCATIONS)
+/***********************************************************************************************************************
+* @brief A function to test that scheduling and completing jobs allocates nothing in steady state
+*
+* @details	For a pool of each scheduler mode and queue backend with 4 threads the same loop runs twice: Schedule,
+*		ScheduleAsync and Post of single jobs, PostBatch of 8 jobs, ScheduleBatch of 4 jobs (the futures go to a
+*		vector which is reused) and a ParallelFor over 64 indices. The first round brings the free lists of
+*		slab_allocator.h up to the load of the loop, the second round must not call operator new at all - neither
+*		on the main thread nor on the threads of the pool.
+*
+* @pre None
+* @post
+* @param[in]  None
+* @return None
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+void run_zero_allocations()
+{
+	for (CTP::ThreadPoolOptions options : all_modes())
+	{
+		options.threadCount = 4;
+		CTP::ThreadPool zalloc_pool(options);
+
+		std::atomic<int> posted(0);
+		auto postJob = [&posted]() { posted++; };
+		const std::vector<decltype(postJob)> postJobs(8, postJob);
+
+		auto scheduleJob = []() { return 3; };
+		const std::vector<decltype(scheduleJob)> scheduleJobs(4, scheduleJob);
+		std::vector<std::future<int>> scheduled;
+		scheduled.reserve(scheduleJobs.size());
+
+		auto hot_loop = [&]()
+		{
+			for (int i = 0; i < 2000; i++)
+			{
+				auto result = zalloc_pool.Schedule([i]() { return i * 2; });
+				const int value = result.get();
+				check(value == i * 2, "Schedule returned a wrong value");
+
+				auto asyncResult = zalloc_pool.ScheduleAsync(CTP::Priority::High, [i]() { return i + 1; });
+				const int asyncValue = asyncResult.Get();
+				check(asyncValue == i + 1, "ScheduleAsync returned a wrong value");
+
+				std::atomic<bool> done(false);
+				zalloc_pool.Post([&done]() { done = true; });
+				while (!done)
+				{
+					std::this_thread::yield();
+				}
+
+				posted = 0;
+				zalloc_pool.PostBatch(postJobs.begin(), postJobs.end());
+				while (posted < 8)
+				{
+					std::this_thread::yield();
+				}
+
+				scheduled.clear();
+				zalloc_pool.ScheduleBatch(scheduleJobs.begin(), scheduleJobs.end(), std::back_inserter(scheduled));
+				int sum = 0;
+				for (auto& future : scheduled)
+				{
+					sum += future.get();
+				}
+				check(12 == sum, "ScheduleBatch returned a wrong value");
+
+				std::atomic<int> indices(0);
+				zalloc_pool.ParallelFor(0, 64, [&indices](int index) { indices += index; });
+				check(63 * 64 / 2 == indices, "ParallelFor missed an index");
+			}
+		};
+
+		// each thread keeps up to MAX_THREAD_BLOCKS free blocks of a size (slab_allocator.cpp) before it gives
+		// any back, so the free lists are filled up only once every thread has run its share of the jobs - the
+		// loop repeats until a round allocates nothing. A call which allocates would do so in every round
+		int rounds = 1;
+		hot_loop();
+		for (;;)
+		{
+			g_allocations = 0;
+			g_countAllocations = true;
+			hot_loop();
+			g_countAllocations = false;
+			if (0 == g_allocations || 10 == rounds)
+			{
+				break;
+			}
+			rounds++;
+		}
+
+		std::cout << "ZALLOC: " << mode_name(options) << ", " << g_allocations << " allocations after " << rounds
+			<< " warm up rounds" << std::endl;
+		check(0 == g_allocations, "the jobs allocated memory in steady state");
+	}
+}
+#endif
+
+/***********************************************************************************************************************
+* @brief Main that creates a thread pool and tests it.
+*
+* @details	Tested with default number of threads (the return of std::thread::hardware_concurrency). Tested also 
+* with 1, 4 and 40 threads. Test Machine - HP ZBook 15 G5 with 16 GB RAM and Intel Core i7-8750H Processor.
+* Built initially with Microsoft Visual Studio 2015 as a console application.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+*
+***********************************************************************************************************************/
+int main()
+{
+	CTP::ThreadPool thread_pool;
+	// CTP::ThreadPool thread_pool(1);
+	// CTP::ThreadPool thread_pool(4);
+	// CTP::ThreadPool thread_pool(40);
+
+#if defined(CTP_TEST_ZERO_ALLOCATIONS)
+	run_zero_allocations();
+#endif
+
+	// example with a short lambda from here:
+	auto resultOf34 = thread_pool.Schedule([]()
+	{
+		int i = 3 * 4;
+		print(std::to_string(i));
+		return i;
+	});
+
+	// example for waiting on a future - get() may be called only once
+	if (resultOf34.wait_for(0ms) != std::future_status::ready)
+	{
+		resultOf34.wait();
+	}
+
+	auto res = resultOf34.get();
+	check(12 == res, "the short lambda returned a wrong value");
+
+	// example with a fire and forget job - no future is created, the result (if any) is discarded
+	thread_pool.Post(CTP::Priority::High, print, std::string("posted"));
+
+	run_parallel_for(thread_pool);
+
+	run_nested_wait(thread_pool);
+
+	run_lock_free_ring();
+
+	run_ring_overflow_order();
+
+	run_spin_idle();
+
+	run_affinity();
+
+	run_presets();
+
+	run_default_thread_count();
+
+	run_numa();
+
+	run_steal_order();
+
+	run_elastic();
+
+	run_hill_climbing();
+
+	run_lazy_start();
+
+	run_stack_size();
+
+	run_worker_hooks();
+
+	run_exception_handler();
+
+	// the demos of the pool modes run on a pool of each scheduler and queue backend
+	for (const CTP::ThreadPoolOptions& options : all_modes())
+	{
+		CTP::ThreadPool mode_pool(options);
+		std::cout << "MODE: " << mode_name(options) << std::endl;
+		run_work_stealing(mode_pool);
+		run_batches(mode_pool);
+		run_parallel_reduce(mode_pool);
+		run_task_graph(mode_pool);
+		run_continuations(mode_pool);
+		run_wakeups(mode_pool);
+		run_worker_local(mode_pool);
+		run_scratch_arena(mode_pool);
+	}
+
+	for(int i = 0; i < 2; i++) run_long_tasks(thread_pool);
+	
+	for (int i = 0; i < 2; i++) run_small_tasks(thread_pool);
+	std::this_thread::sleep_for(5s);
+
+	return 0;
+}
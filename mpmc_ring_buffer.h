@@ -0,0 +1,288 @@
+/***********************************************************************************************************************
+* @file mpmc_ring_buffer.h
+*
+* @brief Bounded lock free multi producer / multi consumer ring buffer used as a queue backend of the Thread Pool.
+*
+* @details	 This is the well known bounded MPMC queue of Dmitry Vyukov. Each cell of the ring carries a sequence
+*	number which tells producers and consumers if the cell is free for the current lap or holds an element.
+*	A producer or a consumer takes a position with a single CAS on the enqueue or dequeue index and then works
+*	on its cell without any further synchronization with the others.
+*
+*  The cells are padded to the cache line size and the first one starts at a cache line boundary, so that two
+*  threads working on neighbouring cells do not invalidate each other's cache lines. The enqueue and dequeue indexes are on separate cache lines as well.
+*
+*  The ring never allocates after construction. When it is full TryPush returns false and it is up to the caller
+*  to put the element somewhere else.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_MPMC_RING_BUFFER_H
+#define CTP_MPMC_RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace CTP
+{
+	template <typename T>
+	class MpmcRingBuffer
+	{
+	public:
+		// the capacity is rounded up to the next power of two
+		explicit MpmcRingBuffer(size_t capacity)
+			: m_capacity(RoundUpToPowerOfTwo(capacity))
+			, m_mask(m_capacity - 1)
+			, m_memory(::operator new(m_capacity * sizeof(Cell) + CACHE_LINE_SIZE))
+			, m_cells(AlignToCacheLine(m_memory))
+			, m_enqueuePos(0)
+			, m_dequeuePos(0)
+		{
+			static_assert(std::alignment_of<T>::value <= CACHE_LINE_SIZE, "over-aligned elements are not supported");
+			static_assert(0 == sizeof(Cell) % CACHE_LINE_SIZE, "a cell must take whole cache lines");
+
+			for (size_t i = 0; i < m_capacity; i++)
+			{
+				new (&m_cells[i]) Cell();
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		~MpmcRingBuffer()
+		{
+			// destroy the elements nobody popped
+			T item;
+			while (TryPop(item))
+			{
+			}
+
+			for (size_t i = 0; i < m_capacity; i++)
+			{
+				m_cells[i].~Cell();
+			}
+			::operator delete(m_memory);
+		}
+
+		MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+		MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Moves the element into the ring. Returns false if the ring is full - the element is then left untouched.
+		//-----------------------------------------------------------------------------
+		bool TryPush(T&& item)
+		{
+			Cell* cell = nullptr;
+			size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+				if (0 == diff)
+				{
+					// the cell is free for this lap - try to take the position
+					if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// the cell still holds the element of the previous lap - the ring is full
+					return false;
+				}
+				else
+				{
+					// another producer took the position meanwhile
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			new (&cell->storage) T(std::move(item));
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Moves up to count elements into the ring with one single reservation of consecutive cells.
+		/// Returns how many elements - always the first ones - were moved. The rest is left untouched.
+		//-----------------------------------------------------------------------------
+		size_t TryPushBulk(T* items, size_t count)
+		{
+			size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+			size_t reserved = 0;
+			for (;;)
+			{
+				// count the consecutive cells which are free for this lap
+				bool stale = false;
+				reserved = 0;
+				while (reserved < count)
+				{
+					const size_t sequence = m_cells[(pos + reserved) & m_mask].sequence.load(std::memory_order_acquire);
+					const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + reserved);
+					if (diff < 0)
+					{
+						break;	// the ring is full from here on
+					}
+					if (diff > 0)
+					{
+						stale = true;	// another producer took this position meanwhile
+						break;
+					}
+					reserved++;
+				}
+
+				if (!stale)
+				{
+					if (0 == reserved)
+					{
+						return 0;
+					}
+					if (m_enqueuePos.compare_exchange_weak(pos, pos + reserved, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else
+				{
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			// all reserved cells are ours now - fill and publish them one by one
+			for (size_t i = 0; i < reserved; i++)
+			{
+				Cell& cell = m_cells[(pos + i) & m_mask];
+				new (&cell.storage) T(std::move(items[i]));
+				cell.sequence.store(pos + i + 1, std::memory_order_release);
+			}
+			return reserved;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Moves the oldest element out of the ring. Returns false if the ring is empty.
+		//-----------------------------------------------------------------------------
+		bool TryPop(T& item)
+		{
+			Cell* cell = nullptr;
+			size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+				if (0 == diff)
+				{
+					// the cell holds an element for this lap - try to take the position
+					if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						break;
+					}
+				}
+				else if (diff < 0)
+				{
+					// the producer of this lap has not written the cell yet - the ring is empty
+					return false;
+				}
+				else
+				{
+					// another consumer took the position meanwhile
+					pos = m_dequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			T* stored = reinterpret_cast<T*>(&cell->storage);
+			item = std::move(*stored);
+			stored->~T();
+			cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Returns true if the ring looks empty. With concurrent pushes and pops this is only a hint.
+		//-----------------------------------------------------------------------------
+		bool Empty() const
+		{
+			const size_t dequeuePos = m_dequeuePos.load(std::memory_order_seq_cst);
+			const Cell& cell = m_cells[dequeuePos & m_mask];
+			return cell.sequence.load(std::memory_order_seq_cst) != dequeuePos + 1;
+		}
+
+		size_t Capacity() const
+		{
+			return m_capacity;
+		}
+
+	private:
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		// the payload of one cell - the sequence number followed by raw storage for the element
+		struct CellData
+		{
+			std::atomic<size_t> sequence;
+			typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type storage;
+		};
+
+		// the bytes up to the next multiple of the cache line size - none if CellData ends on a boundary already
+		static const size_t CELL_PADDING = (CACHE_LINE_SIZE - sizeof(CellData) % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+
+		// one cell padded up to a multiple of the cache line size. A zero sized array is not allowed, so the
+		// cell without padding is a specialization
+		template <size_t Padding, typename Unused = void>
+		struct PaddedCell : CellData
+		{
+			char padding[Padding];
+		};
+
+		template <typename Unused>
+		struct PaddedCell<0, Unused> : CellData
+		{
+		};
+
+		typedef PaddedCell<CELL_PADDING> Cell;
+
+		static Cell* AlignToCacheLine(void* memory)
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+			return reinterpret_cast<Cell*>((address + CACHE_LINE_SIZE - 1) & ~(uintptr_t(CACHE_LINE_SIZE) - 1));
+		}
+
+		static size_t RoundUpToPowerOfTwo(size_t value)
+		{
+			size_t result = 2;
+			while (result < value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		const size_t m_capacity;
+		const size_t m_mask;
+
+		// the cells start at the first cache line boundary of the memory
+		void* const m_memory;
+		Cell* const m_cells;
+
+		// producers and consumers update different indexes - keep them on separate cache lines
+		char m_cellsPadding[CACHE_LINE_SIZE];
+		std::atomic<size_t> m_enqueuePos;
+		char m_enqueuePadding[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> m_dequeuePos;
+		char m_dequeuePadding[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_MPMC_RING_BUFFER_H
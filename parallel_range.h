@@ -0,0 +1,185 @@
+/***********************************************************************************************************************
+* @file parallel_range.h
+*
+* @brief The shared state of one parallel loop of the Thread Pool - it hands out chunks of an iteration range.
+*
+* @details	 A range of count iterations is processed by a number of participants - the thread which started the
+*	loop plus some jobs added to the pool. Each participant repeatedly claims the next chunk of iterations and
+*	passes it to the chunk body, until the whole range is claimed.
+*
+*	The chunks are handed out with guided self scheduling: the size of each chunk is the remaining iterations
+*	divided by twice the number of participants, but never below the grain. The first chunks are big, so the
+*	overhead of claiming is small, and the last chunks are small, so a participant which got slow iterations
+*	does not keep all others waiting at the end. Claiming a chunk is one CAS on an atomic counter.
+*
+*	The chunk body is called as body(chunkBegin, chunkEnd, participant), where participant is 0 for the thread
+*	which started the loop and 1..participants-1 for the helper jobs. The participant index allows per
+*	participant data (e.g. partial results) without any synchronization.
+*
+*	The first exception thrown by the chunk body stops handing out new chunks. It is kept and rethrown by the
+*	thread which started the loop once all chunks in progress are finished.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_PARALLEL_RANGE_H
+#define CTP_PARALLEL_RANGE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+
+namespace CTP
+{
+	template <typename ChunkBody>
+	class ParallelRange
+	{
+	public:
+		// the chunk body is kept by reference - it must outlive the call of Wait
+		ParallelRange(size_t count, size_t grain, size_t participants, const ChunkBody& body)
+			: m_count(count)
+			, m_grain(std::max<size_t>(grain, 1))
+			, m_participants(std::max<size_t>(participants, 1))
+			, m_body(body)
+			, m_next(0)
+			, m_completed(0)
+			, m_failed(false)
+		{
+		}
+
+		ParallelRange(const ParallelRange&) = delete;
+		ParallelRange& operator=(const ParallelRange&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Claims and processes chunks until the range is exhausted.
+		//
+		// The body is touched only after a chunk was claimed - at this moment the thread
+		// which started the loop is still in Wait, so the body is guaranteed to be alive.
+		// A helper job which starts after the range is exhausted returns immediately.
+		//-----------------------------------------------------------------------------
+		void Run(size_t participant)
+		{
+			size_t chunkBegin = 0;
+			size_t chunkEnd = 0;
+			while (Claim(chunkBegin, chunkEnd))
+			{
+				try
+				{
+					m_body(chunkBegin, chunkEnd, participant);
+				}
+				catch (...)
+				{
+					Fail(std::current_exception());
+				}
+				Complete(chunkEnd - chunkBegin);
+			}
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Blocks until every iteration is either processed or cancelled by an exception.
+		//-----------------------------------------------------------------------------
+		void Wait()
+		{
+			std::unique_lock<std::mutex> ul(m_guard);
+			m_cvDone.wait(ul, [this]() { return IsDone(); });
+		}
+
+		// the same as Wait, but returns after the timeout at the latest
+		void WaitFor(std::chrono::microseconds timeout)
+		{
+			std::unique_lock<std::mutex> ul(m_guard);
+			m_cvDone.wait_for(ul, timeout, [this]() { return IsDone(); });
+		}
+
+		// true once every iteration is processed or cancelled
+		bool IsDone() const
+		{
+			return m_completed.load(std::memory_order_acquire) == m_count;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Rethrows the first exception thrown by the body, if there was any. Call it after Wait.
+		//-----------------------------------------------------------------------------
+		void Rethrow()
+		{
+			if (m_exception)
+			{
+				std::rethrow_exception(m_exception);
+			}
+		}
+
+	private:
+		bool Claim(size_t& chunkBegin, size_t& chunkEnd)
+		{
+			size_t current = m_next.load(std::memory_order_relaxed);
+			size_t chunk = 0;
+			do
+			{
+				if (current >= m_count)
+				{
+					return false;
+				}
+				const size_t remaining = m_count - current;
+				chunk = std::min(remaining, std::max(m_grain, remaining / (2 * m_participants)));
+			} while (!m_next.compare_exchange_weak(current, current + chunk, std::memory_order_relaxed));
+
+			chunkBegin = current;
+			chunkEnd = current + chunk;
+			return true;
+		}
+
+		void Complete(size_t iterations)
+		{
+			if (m_completed.fetch_add(iterations, std::memory_order_acq_rel) + iterations == m_count)
+			{
+				// lock so that the waiting thread cannot miss the notification between its check and its wait
+				std::unique_lock<std::mutex> ul(m_guard);
+				m_cvDone.notify_all();
+			}
+		}
+
+		void Fail(std::exception_ptr exception)
+		{
+			if (!m_failed.exchange(true))
+			{
+				m_exception = exception;
+
+				// take all unclaimed iterations away and count them as completed
+				const size_t claimed = m_next.exchange(m_count);
+				if (claimed < m_count)
+				{
+					Complete(m_count - claimed);
+				}
+			}
+		}
+
+		const size_t m_count;
+		const size_t m_grain;
+		const size_t m_participants;
+		const ChunkBody& m_body;
+
+		std::atomic<size_t> m_next;
+		std::atomic<size_t> m_completed;
+
+		// the first exception - written only by the participant which set m_failed
+		std::atomic<bool> m_failed;
+		std::exception_ptr m_exception;
+
+		std::mutex m_guard;
+		std::condition_variable m_cvDone;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_PARALLEL_RANGE_H
@@ -0,0 +1,219 @@
+/***********************************************************************************************************************
+* @file scratch_arena.h
+*
+* @brief Bump allocator for the short lived scratch memory of a job - each thread of the pool owns one.
+*
+* @details	 Jobs which need temporary buffers (a copy of the input, a sort buffer, a small map) allocate them with
+*	new or malloc on every run. All threads then meet in the global allocator, and the memory is freed again right
+*	after the job. A ScratchArena instead hands out memory by moving a pointer forward in a big chunk - a few
+*	instructions, no lock - and frees nothing single. The thread of the pool rewinds the arena of the thread
+*	after each job, so everything a job allocated from it is gone once the job returns.
+*
+*	The chunks are kept after a rewind - once the arena has grown to what the jobs need, no job allocates from
+*	the system any more. A request which does not fit into the current chunk moves on to the next chunk, or to a
+*	new chunk of chunkSize (or bigger, for a bigger request). The first chunk is allocated by the first request,
+*	i.e. on the thread which uses the arena - in a NUMA system its memory is local to the thread.
+*
+*	A thread which waits for a result inside a job executes other jobs in the meantime (see ThreadPool::Wait).
+*	Each of them rewinds only to where the arena was when it started, so the memory of the waiting job survives.
+*
+*	ArenaAllocator<T> lets the standard containers allocate from an arena, e.g.
+*		CTP::ArenaAllocator<int> allocator(*arena);
+*		std::vector<int, CTP::ArenaAllocator<int>> buffer(allocator);
+*	Its deallocate does nothing - the memory comes back with the rewind. The container must not outlive the job.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_SCRATCH_ARENA_H
+#define CTP_SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace CTP
+{
+	class ScratchArena
+	{
+	public:
+		// a position in the arena - see GetMarker and Rewind
+		struct Marker
+		{
+			size_t chunk;
+			size_t used;
+		};
+
+		explicit ScratchArena(size_t chunkSize = 64 * 1024)
+			: m_chunkSize(chunkSize > 0 ? chunkSize : 1)
+		{
+		}
+
+		~ScratchArena()
+		{
+			Release();
+		}
+
+		ScratchArena(const ScratchArena&) = delete;
+		ScratchArena& operator=(const ScratchArena&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Returns size bytes aligned to alignment (a power of two). Throws std::bad_alloc.
+		//-----------------------------------------------------------------------------
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			for (; m_current < m_chunks.size(); m_current++, m_used = 0)
+			{
+				if (void* memory = TryAllocate(m_chunks[m_current], size, alignment))
+				{
+					return memory;
+				}
+			}
+
+			// no chunk left with enough room - the alignment may cost up to alignment - 1 bytes
+			Chunk chunk;
+			chunk.size = size + alignment > m_chunkSize ? size + alignment : m_chunkSize;
+			chunk.memory = static_cast<char*>(::operator new(chunk.size));
+			try
+			{
+				m_chunks.push_back(chunk);
+			}
+			catch (...)
+			{
+				::operator delete(chunk.memory);
+				throw;
+			}
+			m_current = m_chunks.size() - 1;
+			m_used = 0;
+			return TryAllocate(m_chunks[m_current], size, alignment);
+		}
+
+		// the current position - everything allocated after it is freed by Rewind
+		Marker GetMarker() const
+		{
+			Marker marker;
+			marker.chunk = m_current;
+			marker.used = m_used;
+			return marker;
+		}
+
+		// frees everything allocated since the marker was taken. The chunks stay for the next allocations
+		void Rewind(const Marker& marker)
+		{
+			m_current = marker.chunk;
+			m_used = marker.used;
+		}
+
+		// frees everything and returns the chunks to the system
+		void Release()
+		{
+			for (const Chunk& chunk : m_chunks)
+			{
+				::operator delete(chunk.memory);
+			}
+			m_chunks.clear();
+			m_current = 0;
+			m_used = 0;
+		}
+
+		// the bytes of all chunks together
+		size_t GetCapacity() const
+		{
+			size_t capacity = 0;
+			for (const Chunk& chunk : m_chunks)
+			{
+				capacity += chunk.size;
+			}
+			return capacity;
+		}
+
+	private:
+		struct Chunk
+		{
+			char* memory;
+			size_t size;
+		};
+
+		// allocates from the given chunk at m_used - null if the request does not fit
+		void* TryAllocate(const Chunk& chunk, size_t size, size_t alignment)
+		{
+			const uintptr_t begin = reinterpret_cast<uintptr_t>(chunk.memory);
+			const uintptr_t aligned = (begin + m_used + alignment - 1) & ~(uintptr_t(alignment) - 1);
+			const size_t offset = static_cast<size_t>(aligned - begin);
+			if (offset > chunk.size || chunk.size - offset < size)
+			{
+				return nullptr;
+			}
+			m_used = offset + size;
+			return chunk.memory + offset;
+		}
+
+		size_t m_chunkSize;
+		std::vector<Chunk> m_chunks;
+
+		// the chunk the next request is served from, and the bytes of it in use
+		size_t m_current = 0;
+		size_t m_used = 0;
+	};
+
+	// an allocator for the standard containers which takes the memory from a ScratchArena
+	template <typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+
+		explicit ArenaAllocator(ScratchArena& arena)
+			: m_arena(&arena)
+		{
+		}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U>& other)
+			: m_arena(other.GetArena())
+		{
+		}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(m_arena->Allocate(count * sizeof(T), std::alignment_of<T>::value));
+		}
+
+		// the memory is freed by the rewind of the arena
+		void deallocate(T*, size_t)
+		{
+		}
+
+		ScratchArena* GetArena() const
+		{
+			return m_arena;
+		}
+
+	private:
+		ScratchArena* m_arena;
+	};
+
+	template <typename T, typename U>
+	bool operator==(const ArenaAllocator<T>& left, const ArenaAllocator<U>& right)
+	{
+		return left.GetArena() == right.GetArena();
+	}
+
+	template <typename T, typename U>
+	bool operator!=(const ArenaAllocator<T>& left, const ArenaAllocator<U>& right)
+	{
+		return left.GetArena() != right.GetArena();
+	}
+
+} // end of namespace CTP
+
+#endif // CTP_SCRATCH_ARENA_H
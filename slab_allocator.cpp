@@ -0,0 +1,220 @@
+/***********************************************************************************************************************
+* @file slab_allocator.cpp
+*
+* @brief Recycling of the small blocks of memory of the jobs - the implementation.
+*
+* @details	 See slab_allocator.h. The free lists of a thread are plain thread_local arrays, so that reaching them
+*	costs no initialization check. A second thread_local object with a destructor is created on the first use - it
+*	passes the blocks of an exiting thread to the central lists. A block freed by the thread after that (e.g. from
+*	the destructor of another thread_local object) goes to the central list directly.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "slab_allocator.h"
+
+#include <cstdint>
+#include <mutex>
+
+namespace CTP
+{
+	// 64, 128, 256, 512 and 1024 bytes
+	static const size_t SIZE_CLASS_COUNT = 5;
+	static const size_t MIN_BLOCK_SIZE = 64;
+
+	// the memory taken from the system at once
+	static const size_t SLAB_SIZE = 64 * 1024;
+
+	// a thread holding more free blocks of one class passes half of them to the central list
+	static const size_t MAX_THREAD_BLOCKS = 256;
+
+	// the blocks a thread takes from the central list at once
+	static const size_t BATCH_BLOCKS = 64;
+
+	// a free block keeps the link to the next free block in its first bytes
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct FreeList
+	{
+		FreeBlock* head;
+		size_t count;
+	};
+
+	// the lists shared by all threads
+	struct CentralList
+	{
+		std::mutex guard;
+		FreeList blocks = { nullptr, 0 };
+	};
+
+	// never destroyed - a thread may give its blocks back while the static objects are destroyed already
+	static CentralList* GetCentralLists()
+	{
+		static CentralList* lists = new CentralList[SIZE_CLASS_COUNT];
+		return lists;
+	}
+
+	// trivially destructible - see the file header
+	static thread_local FreeList t_freeLists[SIZE_CLASS_COUNT];
+	static thread_local bool t_registered = false;
+	static thread_local bool t_exited = false;
+
+	static size_t GetSizeClass(size_t size)
+	{
+		size_t sizeClass = 0;
+		for (size_t blockSize = MIN_BLOCK_SIZE; blockSize < size; blockSize *= 2)
+		{
+			sizeClass++;
+		}
+		return sizeClass;
+	}
+
+	// moves up to count blocks from one list to another
+	static void MoveBlocks(FreeList& from, FreeList& to, size_t count)
+	{
+		for (; count > 0 && from.head != nullptr; count--)
+		{
+			FreeBlock* block = from.head;
+			from.head = block->next;
+			from.count--;
+			block->next = to.head;
+			to.head = block;
+			to.count++;
+		}
+	}
+
+	// cuts a new slab into blocks of the given class, all for the central list. Called with its lock held
+	static void AddSlab(size_t sizeClass, FreeList& central)
+	{
+		const size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+		char* memory = static_cast<char*>(::operator new(SLAB_SIZE + MIN_BLOCK_SIZE));
+		const uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+		char* first = memory + ((MIN_BLOCK_SIZE - address % MIN_BLOCK_SIZE) % MIN_BLOCK_SIZE);
+		for (size_t offset = 0; offset + blockSize <= SLAB_SIZE; offset += blockSize)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(first + offset);
+			block->next = central.head;
+			central.head = block;
+			central.count++;
+		}
+	}
+
+	// gives the blocks of an exiting thread to the central lists
+	struct ThreadListsOwner
+	{
+		~ThreadListsOwner()
+		{
+			CentralList* central = GetCentralLists();
+			for (size_t i = 0; i < SIZE_CLASS_COUNT; i++)
+			{
+				std::unique_lock<std::mutex> ul(central[i].guard);
+				MoveBlocks(t_freeLists[i], central[i].blocks, t_freeLists[i].count);
+			}
+			t_exited = true;
+		}
+	};
+
+	static void RegisterThread()
+	{
+		static thread_local ThreadListsOwner owner;
+		(void)owner;
+		t_registered = true;
+	}
+
+	void* SlabAllocate(size_t size)
+	{
+		if (size > MAX_SLAB_BLOCK_SIZE)
+		{
+			return ::operator new(size);
+		}
+
+		const size_t sizeClass = GetSizeClass(size);
+		if (t_exited)
+		{
+			CentralList& central = GetCentralLists()[sizeClass];
+			std::unique_lock<std::mutex> ul(central.guard);
+			if (nullptr == central.blocks.head)
+			{
+				AddSlab(sizeClass, central.blocks);
+			}
+			FreeList single = { nullptr, 0 };
+			MoveBlocks(central.blocks, single, 1);
+			return single.head;
+		}
+
+		if (!t_registered)
+		{
+			RegisterThread();
+		}
+
+		FreeList& local = t_freeLists[sizeClass];
+		if (nullptr == local.head)
+		{
+			CentralList& central = GetCentralLists()[sizeClass];
+			std::unique_lock<std::mutex> ul(central.guard);
+			if (nullptr == central.blocks.head)
+			{
+				AddSlab(sizeClass, central.blocks);
+			}
+			MoveBlocks(central.blocks, local, BATCH_BLOCKS);
+		}
+
+		FreeBlock* block = local.head;
+		local.head = block->next;
+		local.count--;
+		return block;
+	}
+
+	void SlabDeallocate(void* block, size_t size)
+	{
+		if (nullptr == block)
+		{
+			return;
+		}
+		if (size > MAX_SLAB_BLOCK_SIZE)
+		{
+			::operator delete(block);
+			return;
+		}
+
+		const size_t sizeClass = GetSizeClass(size);
+		FreeBlock* freed = static_cast<FreeBlock*>(block);
+		if (t_exited)
+		{
+			CentralList& central = GetCentralLists()[sizeClass];
+			std::unique_lock<std::mutex> ul(central.guard);
+			freed->next = central.blocks.head;
+			central.blocks.head = freed;
+			central.blocks.count++;
+			return;
+		}
+
+		if (!t_registered)
+		{
+			RegisterThread();
+		}
+
+		FreeList& local = t_freeLists[sizeClass];
+		freed->next = local.head;
+		local.head = freed;
+		local.count++;
+
+		if (local.count > MAX_THREAD_BLOCKS)
+		{
+			CentralList& central = GetCentralLists()[sizeClass];
+			std::unique_lock<std::mutex> ul(central.guard);
+			MoveBlocks(local, central.blocks, MAX_THREAD_BLOCKS / 2);
+		}
+	}
+
+} // end of namespace CTP
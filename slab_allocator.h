@@ -0,0 +1,99 @@
+/***********************************************************************************************************************
+* @file slab_allocator.h
+*
+* @brief Recycling of the small blocks of memory which each job needs - the job nodes, the shared states of the
+*	futures and the blocks of the job queues - without the global allocator.
+*
+* @details	 Every Schedule allocates the shared state of its future, and the queues allocate nodes for the jobs
+*	they hold. These blocks are small, of a few fixed sizes and live only until the job is done - the ideal case
+*	for a free list: a freed block is not given back to the system but kept for the next request of the same size.
+*
+*	The blocks are grouped in size classes of 64, 128, 256, 512 and 1024 bytes. Each thread keeps a free list
+*	per class without any lock. A thread which frees more blocks than it allocates (e.g. the thread executing
+*	the jobs, while another one schedules them) passes half of its list to a central list once it holds too many,
+*	and a thread which runs out takes a batch from there - one lock per batch, not per block. Only when the central
+*	list is empty a new slab of 64 KB is taken from the system and cut into blocks.
+*
+*	The slabs are never returned to the system - the memory stays at the highest number of jobs in flight at once,
+*	and from then on scheduling and completing jobs allocates nothing. The blocks start at a cache line boundary,
+*	so a Job (64 bytes) occupies exactly one cache line. Requests above 1024 bytes go to the global operator new.
+*
+*	SlabAllocator<T> is the same as a standard allocator - for std::allocate_shared, std::promise and the
+*	standard containers. The free lists are shared by all pools of the process.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_SLAB_ALLOCATOR_H
+#define CTP_SLAB_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace CTP
+{
+	// the biggest block served from the free lists - bigger requests go to the global operator new
+	static const size_t MAX_SLAB_BLOCK_SIZE = 1024;
+
+	//-----------------------------------------------------------------------------
+	/// Returns a block of at least size bytes, aligned to a cache line if size is up
+	/// to MAX_SLAB_BLOCK_SIZE. Throws std::bad_alloc.
+	//-----------------------------------------------------------------------------
+	void* SlabAllocate(size_t size);
+
+	//-----------------------------------------------------------------------------
+	/// Gives a block back - size must be the size it was allocated with. Any thread
+	/// may free a block, not only the one which allocated it.
+	//-----------------------------------------------------------------------------
+	void SlabDeallocate(void* block, size_t size);
+
+	template <typename T>
+	class SlabAllocator
+	{
+	public:
+		typedef T value_type;
+
+		SlabAllocator() = default;
+
+		template <typename U>
+		SlabAllocator(const SlabAllocator<U>&)
+		{
+		}
+
+		T* allocate(size_t count)
+		{
+			static_assert(std::alignment_of<T>::value <= std::alignment_of<std::max_align_t>::value,
+				"over-aligned types are not supported");
+			return static_cast<T*>(SlabAllocate(count * sizeof(T)));
+		}
+
+		void deallocate(T* pointer, size_t count)
+		{
+			SlabDeallocate(pointer, count * sizeof(T));
+		}
+	};
+
+	// all SlabAllocators share the same free lists - memory of one can be freed by any other
+	template <typename T, typename U>
+	bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&)
+	{
+		return true;
+	}
+
+	template <typename T, typename U>
+	bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&)
+	{
+		return false;
+	}
+
+} // end of namespace CTP
+
+#endif // CTP_SLAB_ALLOCATOR_H
@@ -0,0 +1,37 @@
+/***********************************************************************************************************************
+* @file system_file.h
+*
+* @brief Reading of the small text files of the system - /sys, /proc and the cgroup file system.
+*
+* @details	 The topology discovery (cpu_topology.cpp) and the default thread count (thread_count.cpp) read many
+*	one line files, e.g. "/sys/devices/system/node/online" or "cpu.max" of a cgroup. A file which cannot be read
+*	is not an error - the callers fall back to a simpler assumption.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_SYSTEM_FILE_H
+#define CTP_SYSTEM_FILE_H
+
+#include <fstream>
+#include <string>
+
+namespace CTP
+{
+	// reads the first line of a small text file, e.g. of /sys. Returns false if the file cannot be read
+	inline bool ReadFirstLine(const std::string& path, std::string& line)
+	{
+		std::ifstream file(path);
+		return file && std::getline(file, line);
+	}
+
+} // end of namespace CTP
+
+#endif // CTP_SYSTEM_FILE_H
@@ -0,0 +1,349 @@
+/***********************************************************************************************************************
+* @file task_graph.cpp
+*
+* @brief Task dependency graph (DAG) executed on the Thread Pool - the implementation.
+*
+* @details	 See task_graph.h. The in-degree of each node is computed while the graph is built and copied to an
+*	atomic counter at the start of each execution - this is the whole setup cost of a Run.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "task_graph.h"
+
+#include <stdexcept>
+#include <utility>
+
+namespace CTP
+{
+	// marks "no node" in the chain of successors executed on the same thread
+	static const TaskGraph::NodeId NO_NODE = static_cast<TaskGraph::NodeId>(-1);
+
+	struct TaskGraph::Node
+	{
+		std::function<void()> work;
+		Priority priority;
+		std::vector<NodeId> successors;
+
+		// the number of incoming edges - fixed once the graph is built
+		size_t predecessors;
+
+		// the predecessors not yet finished in the current execution
+		std::atomic<size_t> pending;
+	};
+
+	// the job of a node in the pool. A job destroyed without being executed reports the node as dropped
+	struct TaskGraph::NodeJob
+	{
+		NodeJob(TaskGraph* graph, NodeId id)
+			: m_graph(graph)
+			, m_id(id)
+		{
+		}
+
+		NodeJob(NodeJob&& other) noexcept
+			: m_graph(other.m_graph)
+			, m_id(other.m_id)
+		{
+			other.m_graph = nullptr;
+		}
+
+		NodeJob(const NodeJob&) = delete;
+		NodeJob& operator=(const NodeJob&) = delete;
+
+		~NodeJob()
+		{
+			if (m_graph != nullptr)
+			{
+				m_graph->DropNode(m_id);
+			}
+		}
+
+		void operator()()
+		{
+			TaskGraph* graph = m_graph;
+			m_graph = nullptr;
+			graph->RunNode(m_id);
+		}
+
+	private:
+		TaskGraph* m_graph;
+		NodeId m_id;
+	};
+
+	TaskGraph::TaskGraph()
+		: m_validated(true)
+		, m_running(false)
+		, m_remaining(0)
+		, m_failed(false)
+		, m_pool(nullptr)
+	{
+	}
+
+	TaskGraph::~TaskGraph()
+	{
+		std::unique_lock<std::mutex> ul(m_guard);
+		m_cvFinished.wait(ul, [this]() { return !m_running.load(std::memory_order_acquire); });
+	}
+
+	TaskGraph::NodeId TaskGraph::AddNode(std::function<void()> work, Priority priority)
+	{
+		ThrowIfRunning();
+
+		std::unique_ptr<Node> node(new Node());
+		node->work = std::move(work);
+		node->priority = priority;
+		node->predecessors = 0;
+		node->pending = 0;
+		m_nodes.push_back(std::move(node));
+		return m_nodes.size() - 1;
+	}
+
+	void TaskGraph::AddEdge(NodeId from, NodeId to)
+	{
+		ThrowIfRunning();
+
+		if (from >= m_nodes.size() || to >= m_nodes.size())
+		{
+			throw std::out_of_range("TaskGraph::AddEdge - unknown node");
+		}
+
+		m_nodes[from]->successors.push_back(to);
+		m_nodes[to]->predecessors++;
+		m_validated = false;
+	}
+
+	size_t TaskGraph::GetNodeCount() const
+	{
+		return m_nodes.size();
+	}
+
+	bool TaskGraph::IsRunning() const
+	{
+		return m_running.load(std::memory_order_acquire);
+	}
+
+	/***********************************************************************************************************************
+	* @brief Starts one execution of the graph on the pool.
+	*
+	* @details	Resets the counters of all nodes and posts the nodes without predecessors. Everything else is started
+	*	by the finishing nodes themselves, so this function returns immediately.
+	*
+	* @pre The graph is not running
+	* @post None
+	* @param[in]  ThreadPool& pool - the pool executing the nodes
+	* @return std::future<void> - ready when all nodes are finished
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	std::future<void> TaskGraph::Run(ThreadPool& pool)
+	{
+		if (m_running.exchange(true, std::memory_order_acq_rel))
+		{
+			throw std::logic_error("TaskGraph::Run - the graph is already running");
+		}
+
+		if (!m_validated)
+		{
+			try
+			{
+				Validate();
+			}
+			catch (...)
+			{
+				m_running.store(false, std::memory_order_release);
+				throw;
+			}
+			m_validated = true;
+		}
+
+		m_done = std::promise<void>();
+		std::future<void> result = m_done.get_future();
+
+		if (m_nodes.empty())
+		{
+			m_running.store(false, std::memory_order_release);
+			m_done.set_value();
+			return result;
+		}
+
+		m_pool = &pool;
+		m_failed.store(false, std::memory_order_relaxed);
+		m_exception = nullptr;
+		for (auto& node : m_nodes)
+		{
+			node->pending.store(node->predecessors, std::memory_order_relaxed);
+		}
+		m_remaining.store(m_nodes.size(), std::memory_order_release);
+
+		// the roots are collected before the first one is posted - once posted, the nodes change the counters
+		std::vector<NodeId> roots;
+		for (NodeId id = 0; id < m_nodes.size(); id++)
+		{
+			if (0 == m_nodes[id]->predecessors)
+			{
+				roots.push_back(id);
+			}
+		}
+		for (NodeId root : roots)
+		{
+			Launch(root);
+		}
+		return result;
+	}
+
+	void TaskGraph::Validate() const
+	{
+		// Kahn's algorithm - if not all nodes can be ordered topologically, there is a cycle
+		std::vector<size_t> inDegree(m_nodes.size());
+		std::vector<NodeId> ready;
+		for (NodeId id = 0; id < m_nodes.size(); id++)
+		{
+			inDegree[id] = m_nodes[id]->predecessors;
+			if (0 == inDegree[id])
+			{
+				ready.push_back(id);
+			}
+		}
+
+		size_t ordered = 0;
+		while (!ready.empty())
+		{
+			const NodeId id = ready.back();
+			ready.pop_back();
+			ordered++;
+			for (NodeId successor : m_nodes[id]->successors)
+			{
+				if (0 == --inDegree[successor])
+				{
+					ready.push_back(successor);
+				}
+			}
+		}
+
+		if (ordered != m_nodes.size())
+		{
+			throw std::invalid_argument("TaskGraph::Run - the graph has a cycle");
+		}
+	}
+
+	void TaskGraph::Launch(NodeId id)
+	{
+		m_pool->Post(m_nodes[id]->priority, NodeJob(this, id));
+	}
+
+	void TaskGraph::DropNode(NodeId id)
+	{
+		if (!m_failed.exchange(true, std::memory_order_acq_rel))
+		{
+			m_exception = std::make_exception_ptr(std::future_error(std::future_errc::broken_promise));
+		}
+
+		// the node is not executed as the execution has failed - it only releases its successors. Those are
+		// posted to the pool again and, if the pool drops them as well, end up here
+		RunNode(id);
+	}
+
+	/***********************************************************************************************************************
+	* @brief Executes a node and releases its successors.
+	*
+	* @details	After the work of the node every successor's counter is decremented. The successors which become
+	*	ready are posted, except one with the same priority which is executed next on this thread - this saves a
+	*	round trip through the queue for chains of nodes. The last finishing node completes the future.
+	*
+	* @pre The node is ready - all its predecessors are finished
+	* @post None
+	* @param[in]  NodeId id - the node to execute
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void TaskGraph::RunNode(NodeId id)
+	{
+		while (NO_NODE != id)
+		{
+			Node& node = *m_nodes[id];
+
+			// after a failure the remaining nodes are only counted down, not executed
+			if (!m_failed.load(std::memory_order_acquire))
+			{
+				try
+				{
+					node.work();
+				}
+				catch (...)
+				{
+					if (!m_failed.exchange(true, std::memory_order_acq_rel))
+					{
+						m_exception = std::current_exception();
+					}
+				}
+			}
+
+			NodeId next = NO_NODE;
+			for (NodeId successorId : node.successors)
+			{
+				Node& successor = *m_nodes[successorId];
+				if (1 == successor.pending.fetch_sub(1, std::memory_order_acq_rel))
+				{
+					if (NO_NODE == next && successor.priority == node.priority)
+					{
+						next = successorId;
+					}
+					else
+					{
+						Launch(successorId);
+					}
+				}
+			}
+
+			if (1 == m_remaining.fetch_sub(1, std::memory_order_acq_rel))
+			{
+				// the last node - the promise is moved out first, as the moment m_running is false the graph
+				// may be run again or destroyed by another thread. The flag is cleared under the lock, so a
+				// destructor waiting for it returns only after the notification
+				std::promise<void> done = std::move(m_done);
+				std::exception_ptr exception = m_exception;
+				{
+					std::unique_lock<std::mutex> ul(m_guard);
+					m_running.store(false, std::memory_order_release);
+					m_cvFinished.notify_all();
+				}
+
+				if (exception)
+				{
+					done.set_exception(exception);
+				}
+				else
+				{
+					done.set_value();
+				}
+				return;
+			}
+
+			id = next;
+		}
+	}
+
+	void TaskGraph::ThrowIfRunning() const
+	{
+		if (m_running.load(std::memory_order_acquire))
+		{
+			throw std::logic_error("TaskGraph - the graph cannot be modified while running");
+		}
+	}
+
+} // end of namespace CTP
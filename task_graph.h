@@ -0,0 +1,124 @@
+/***********************************************************************************************************************
+* @file task_graph.h
+*
+* @brief Task dependency graph (DAG) executed on the Thread Pool.
+*
+* @details	 A TaskGraph consists of nodes - callables with no arguments and no result - and edges between them.
+*	An edge from A to B means B may start only once A is finished. The graph is built once and can then be
+*	run many times (e.g. once per frame) without rebuilding it.
+*
+*	When the graph runs, every node keeps an atomic counter of its unfinished predecessors. The nodes without
+*	predecessors are posted to the pool at once. A finishing node decrements the counters of its successors and
+*	every successor reaching zero is started immediately - so no thread ever blocks waiting for a dependency.
+*	One ready successor with the same priority is executed directly on the same thread, the others are posted.
+*
+*	Run returns a std::future<void> which becomes ready when all nodes are finished. If a node throws, the
+*	nodes not yet started are skipped and the first exception is delivered through the future. A node which the
+*	pool drops without executing it (e.g. because the pool shuts down) fails the execution the same way, with
+*	std::future_error(broken_promise) - the execution always finishes.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_TASK_GRAPH_H
+#define CTP_TASK_GRAPH_H
+
+#include "thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CTP
+{
+	class TaskGraph
+	{
+	public:
+		typedef size_t NodeId;
+
+		TaskGraph();
+
+		// waits for a running execution to finish - the nodes reference the graph
+		~TaskGraph();
+
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Adds a node. The work is called once per Run, so it must be callable repeatedly.
+		//-----------------------------------------------------------------------------
+		NodeId AddNode(std::function<void()> work, Priority priority = Priority::Normal);
+
+		//-----------------------------------------------------------------------------
+		/// Declares that the node to starts only after the node from is finished.
+		//-----------------------------------------------------------------------------
+		void AddEdge(NodeId from, NodeId to);
+
+		//-----------------------------------------------------------------------------
+		/// Starts one execution of the whole graph on the pool and returns at once.
+		//
+		// The returned future becomes ready when all nodes are finished or carries the
+		// first exception thrown by a node. Only one execution may run at a time - calling
+		// Run again before the future is ready throws std::logic_error. A graph with a
+		// cycle throws std::invalid_argument. The pool must outlive the execution.
+		//-----------------------------------------------------------------------------
+		std::future<void> Run(ThreadPool& pool);
+
+		size_t GetNodeCount() const;
+
+		// true while an execution started by Run is not finished
+		bool IsRunning() const;
+
+	private:
+		struct Node;
+		struct NodeJob;
+
+		// throws std::invalid_argument if the graph has a cycle
+		void Validate() const;
+
+		// executes the node and then, on the same thread, the chain of its ready successors
+		void RunNode(NodeId id);
+
+		// posts a ready node to the pool
+		void Launch(NodeId id);
+
+		// the pool destroyed the job of a node without executing it - fails the execution and counts the node
+		// and the nodes depending on it down, so that the execution finishes nevertheless
+		void DropNode(NodeId id);
+
+		// throws std::logic_error when the graph is running - it cannot be modified or started then
+		void ThrowIfRunning() const;
+
+		std::vector<std::unique_ptr<Node>> m_nodes;
+
+		// false after each modification - the graph is checked for cycles again on the next Run
+		bool m_validated;
+
+		// the state of the current execution
+		std::atomic<bool> m_running;
+		std::atomic<size_t> m_remaining;
+		std::atomic<bool> m_failed;
+		std::exception_ptr m_exception;
+		std::promise<void> m_done;
+		ThreadPool* m_pool;
+
+		// the destructor waits on this for the end of the execution
+		std::mutex m_guard;
+		std::condition_variable m_cvFinished;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_TASK_GRAPH_H
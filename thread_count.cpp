@@ -0,0 +1,248 @@
+/***********************************************************************************************************************
+* @file thread_count.cpp
+*
+* @brief The default number of threads of the pool - the implementation.
+*
+* @details	 See thread_count.h. The cgroup of the process is taken from /proc/self/cgroup and the place where the
+*	cgroup file system is mounted from /proc/self/mountinfo, so that the quota is found also in containers,
+*	where the cgroup of the process is usually the root of the mounted hierarchy.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "thread_count.h"
+#include "cpu_affinity.h"
+#include "system_file.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace CTP
+{
+	// the CPU limit of one cgroup - in CPUs, e.g. 2.5 for "250000 100000"
+	struct CgroupLimit
+	{
+		double cpus = 0;
+		std::string source;
+	};
+
+	// splits the text at each separator
+	static std::vector<std::string> Split(const std::string& text, char separator)
+	{
+		std::vector<std::string> parts;
+		std::istringstream stream(text);
+		std::string part;
+		while (std::getline(stream, part, separator))
+		{
+			parts.push_back(part);
+		}
+		return parts;
+	}
+
+	// the directory of the given cgroup of the process, found through the mount of its hierarchy. Empty if the
+	// hierarchy is not mounted. For cgroup v1 the hierarchy is the one with the given controller
+	static std::string FindCgroupDirectory(const std::string& cgroupPath, bool version2, const std::string& controller)
+	{
+		std::ifstream mountInfo("/proc/self/mountinfo");
+		std::string line;
+		while (std::getline(mountInfo, line))
+		{
+			// "36 35 0:30 <root> <mount point> <options> <optional fields> - <type> <source> <super options>"
+			const size_t separator = line.find(" - ");
+			if (std::string::npos == separator)
+			{
+				continue;
+			}
+			const std::vector<std::string> fields = Split(line.substr(0, separator), ' ');
+			const std::vector<std::string> tail = Split(line.substr(separator + 3), ' ');
+			if (fields.size() < 5 || tail.size() < 3)
+			{
+				continue;
+			}
+
+			bool matches = false;
+			if (version2)
+			{
+				matches = "cgroup2" == tail[0];
+			}
+			else if ("cgroup" == tail[0])
+			{
+				for (const std::string& option : Split(tail[2], ','))
+				{
+					matches = matches || controller == option;
+				}
+			}
+			if (!matches)
+			{
+				continue;
+			}
+
+			// the mount shows the hierarchy from fields[3] on - strip it from the path of the process
+			const std::string& root = fields[3];
+			std::string relative = cgroupPath;
+			if ("/" != root && 0 == relative.compare(0, root.size(), root))
+			{
+				relative = relative.substr(root.size());
+			}
+			const std::string& mountPoint = fields[4];
+			return "/" == relative || relative.empty() ? mountPoint : mountPoint + relative;
+		}
+		return std::string();
+	}
+
+	// the limit of one cgroup v2 directory - false if there is none ("max")
+	static bool ReadCgroupV2Limit(const std::string& directory, CgroupLimit& limit)
+	{
+		std::string line;
+		if (!ReadFirstLine(directory + "/cpu.max", line))
+		{
+			return false;
+		}
+		std::istringstream stream(line);
+		std::string quota;
+		double period = 0;
+		if (!(stream >> quota >> period) || "max" == quota || period <= 0)
+		{
+			return false;
+		}
+		limit.cpus = std::atof(quota.c_str()) / period;
+		limit.source = directory + "/cpu.max = " + line;
+		return limit.cpus > 0;
+	}
+
+	// the limit of one cgroup v1 directory - false if there is none (quota -1)
+	static bool ReadCgroupV1Limit(const std::string& directory, CgroupLimit& limit)
+	{
+		std::string quotaLine;
+		std::string periodLine;
+		if (!ReadFirstLine(directory + "/cpu.cfs_quota_us", quotaLine) || !ReadFirstLine(directory + "/cpu.cfs_period_us", periodLine))
+		{
+			return false;
+		}
+		const double quota = std::atof(quotaLine.c_str());
+		const double period = std::atof(periodLine.c_str());
+		if (quota <= 0 || period <= 0)
+		{
+			return false;
+		}
+		limit.cpus = quota / period;
+		limit.source = directory + "/cpu.cfs_quota_us = " + quotaLine + ", cpu.cfs_period_us = " + periodLine;
+		return true;
+	}
+
+	/***********************************************************************************************************************
+	* @brief Finds the smallest CPU quota of the cgroup of the process and all its parents.
+	*
+	* @details	A quota set on a parent cgroup (e.g. the pod in Kubernetes) limits all cgroups below it, so the
+	*	directories are checked from the cgroup of the process up to the mount point of the hierarchy.
+	*
+	* @pre None
+	* @post None
+	* @param[out]  CgroupLimit& limit - the smallest quota and where it was found
+	* @return bool - false if there is no quota at all
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	static bool FindCgroupLimit(CgroupLimit& limit)
+	{
+		bool found = false;
+		std::ifstream cgroups("/proc/self/cgroup");
+		std::string line;
+		while (std::getline(cgroups, line))
+		{
+			// "<hierarchy id>:<controllers>:<path>" - "0::<path>" for cgroup v2
+			const size_t first = line.find(':');
+			const size_t second = line.find(':', first + 1);
+			if (std::string::npos == first || std::string::npos == second)
+			{
+				continue;
+			}
+			const std::string controllers = line.substr(first + 1, second - first - 1);
+			const std::string path = line.substr(second + 1);
+
+			bool version2 = controllers.empty();
+			bool hasCpu = version2;
+			for (const std::string& controller : Split(controllers, ','))
+			{
+				hasCpu = hasCpu || "cpu" == controller;
+			}
+			if (!hasCpu)
+			{
+				continue;
+			}
+
+			const std::string mountPoint = FindCgroupDirectory("/", version2, "cpu");
+			std::string directory = FindCgroupDirectory(path, version2, "cpu");
+			while (!directory.empty())
+			{
+				CgroupLimit candidate;
+				const bool limited = version2 ? ReadCgroupV2Limit(directory, candidate) : ReadCgroupV1Limit(directory, candidate);
+				if (limited && (!found || candidate.cpus < limit.cpus))
+				{
+					limit = candidate;
+					found = true;
+				}
+
+				// one level up, but not above the mount point of the hierarchy
+				const size_t slash = directory.find_last_of('/');
+				if (directory == mountPoint || std::string::npos == slash || directory.size() <= mountPoint.size())
+				{
+					break;
+				}
+				directory = directory.substr(0, slash);
+			}
+		}
+		return found;
+	}
+
+	DefaultThreadCount GetDefaultThreadCount()
+	{
+		DefaultThreadCount result;
+		result.count = std::thread::hardware_concurrency();
+		result.reason = "std::thread::hardware_concurrency() = " + std::to_string(result.count);
+		if (0 == result.count)
+		{
+			// hardware_concurrency may return 0 if it is not known
+			result.count = 1;
+			result.reason = "std::thread::hardware_concurrency() unknown - 1 thread";
+		}
+
+		const size_t affinityCpus = GetAvailableCpus().size();
+		if (affinityCpus > 0 && affinityCpus < result.count)
+		{
+			result.count = affinityCpus;
+			result.reason = "affinity mask of the process (sched_getaffinity) allows " + std::to_string(affinityCpus)
+				+ " CPUs";
+		}
+
+		CgroupLimit limit;
+		if (FindCgroupLimit(limit))
+		{
+			const size_t quotaCpus = static_cast<size_t>(std::ceil(limit.cpus - 1e-9));
+			const size_t count = quotaCpus > 0 ? quotaCpus : 1;
+			if (count < result.count)
+			{
+				result.count = count;
+				std::ostringstream reason;
+				reason << "cgroup CPU quota of " << limit.cpus << " CPUs (" << limit.source << ")";
+				result.reason = reason.str();
+			}
+		}
+		return result;
+	}
+
+} // end of namespace CTP
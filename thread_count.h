@@ -0,0 +1,60 @@
+/***********************************************************************************************************************
+* @file thread_count.h
+*
+* @brief The default number of threads of the pool - the CPUs the process may really use.
+*
+* @details	 std::thread::hardware_concurrency() reports all CPUs of the machine. A process may be allowed much
+*	less: its affinity mask (taskset, cpusets) may contain only some of the CPUs, and in a container the cgroup
+*	CPU quota (docker --cpus, the Kubernetes CPU limit) allows only a share of the CPU time. A pool with one
+*	thread per CPU of the host then has far more threads than it can run, they are throttled by the quota and
+*	the latency of the jobs explodes.
+*
+*	GetDefaultThreadCount takes the smallest of:
+*
+*	- std::thread::hardware_concurrency()
+*	- the number of CPUs in the affinity mask of the process (sched_getaffinity)
+*	- the cgroup CPU quota rounded up - cpu.max for cgroup v2, cpu.cfs_quota_us / cpu.cfs_period_us for cgroup
+*	  v1. The quotas of all parent cgroups are taken into account as well
+*
+*	and returns the reason for the result next to it, so that it can be logged. This is the thread count of
+*	ThreadPool() and of the default ThreadPoolOptions. Only Linux has affinity masks and cgroups - elsewhere the
+*	result is std::thread::hardware_concurrency().
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_THREAD_COUNT_H
+#define CTP_THREAD_COUNT_H
+
+#include <cstddef>
+#include <string>
+
+namespace CTP
+{
+	struct DefaultThreadCount
+	{
+		// at least 1
+		size_t count;
+
+		// a human readable explanation which limit gave the count - e.g. for the log of the application
+		std::string reason;
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The number of threads the process can really run at the same time.
+	//
+	// The smallest of hardware_concurrency, the affinity mask and the cgroup quota.
+	// Reads /proc and /sys on each call - keep the result instead of calling it often.
+	//-----------------------------------------------------------------------------
+	DefaultThreadCount GetDefaultThreadCount();
+
+} // end of namespace CTP
+
+#endif // CTP_THREAD_COUNT_H
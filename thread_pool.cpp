@@ -1,296 +1,1912 @@
-/***********************************************************************************************************************
-* @file thread_pool.cpp
-*
-* @brief Template based Thread Pool - the Pimpl concept implementation. It accepts 3 types of jobs by priority.
-*
-* @details	 This Thread pool is created as a class with template based functions to ensure
-*	different possible input job types - a lambda, a class method, a functor or a function.
-*
-*	It is based on the Pimpl paradigm:
-*	"Pointer to implementation" or "pImpl" is a C++ programming technique[1] that removes
-*  implementation details of a class from its object representation by placing them in a
-*  separate class, accessed through an opaque pointer
-* 
-*  The jobs insertion and extraction is kept safe via one single mutex to avoid race conditions.
-* 
-*  The Queues are 3 - Critical (2), High (1), and Normal(0) Priority
-* 
-*  Each Thread sequentially checks the Queues from a map of Key-Value Pairs - a pair fo the priority and 
-*  an element from a vector of threads.
-*  
-*  Once all queues are empty - the current thread is blocked until notified via a condition variable.
-*  
-*  The Condition variable wait is blocking the thread in a sleep mode.
-*  
-*  There is a shutdown function which ensures all threads will stop taking new jobs based on a boolean flag.
-*  It is called in the destructor. It will join all threads and wait for the end of each of them to execute
-*  and exit.
-*  
-*  The code is based completely on C++11 features. The purpose is to be able to integrate it
-*  in older projects which have not yet reached C++14 or higher. If you need newer features
-*  fork the code and get it to the next level yourself.
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
-*
-***********************************************************************************************************************/
-
-#include "thread_pool.h"
-
-#include <thread>
-#include <map>
-#include <mutex>
-#include <queue>
-#include <string>
-#include <vector>
-
-namespace CTP
-{
-	//-----------------------------------------------------------------------------
-	/// Thread Pool Implementation
-	//-----------------------------------------------------------------------------
-	class ThreadPool::impl
-	{
-	public:
-		// the main function for initializing the pool and starting the threads
-		void Init(size_t threadCount);
-
-		// explicitly shutdown the threads - call this obligatory when wanting 
-		// the threads to be stopped. Currently this is performed
-		// in the destructor relieving the user from the need to call it himself!
-		void Shutdown();
-
-		// the AddJob function takes an Rvalue (double reference) to a std::function object.
-		// This std::function object contains a Callable that returns no result and takes no arguments
-		void AddJob(std::function<void()>&& job, Priority priority);
-
-	private:
-		// this flag is used to control the main loop in the Init function. While it is true the cycle will continue 
-		// popping jobs out from the queue. 
-		// Initialized as true so that once Init is called the Thread Pool is operational.
-		bool m_running = true;
-
-		// m_guard is a mutex that is used while adding a job or extracting one from the queue.
-		// Together with the condition variable these control adding jobs to the queue
-		// and extracting them so that there are no race conditions.
-		std::mutex m_guard;
-		std::condition_variable m_cvSleepCtrl;
-
-		// the vector of threads which will process the jobs
-		std::vector<std::thread> m_workers;
-
-		// a map of kvp - Key-Value Pair. The pair is the priority level together with it's 
-		// corresponding dedicated Queue. This means for each priority we have a separate Queue
-		// the last part - std::greater<Priority> - sorts the map in descending order based on the Priority!
-		std::map<Priority, std::queue<std::function<void()>>, std::greater<Priority> > m_jobsByPriority;
-	};
-
-	// The Constructor simply initializes a single pointer based on the template from the header file in the member:
-	// std::unique_ptr<impl> m_impl;
-	ThreadPool::ThreadPool(size_t threadCount)
-		: m_impl(std::make_unique<ThreadPool::impl>())
-	{
-		// the only functionality of the Constructor us to call the Init which effectively starts the threads
-		// you can of course add more functionality here
-		m_impl->Init(threadCount);
-	}
-
-	// Destructor 
-	ThreadPool::~ThreadPool()
-	{
-		// Via a call to Shutdown(): Simply notify all threads to finish their work by waking them up.
-		// In addition the boolean flag that controlls the execution of the threads is set to false.
-		m_impl->Shutdown();
-	}
-
-	void ThreadPool::AddJob(std::function<void()> job, Priority priority)
-	{
-		m_impl->AddJob(std::move(job), priority);
-	}
-
-	/***********************************************************************************************************************
-	* @brief The main function for initializing the pool and starting the threads.
-	* 
-	* @details	This is the main function that starts the threads and feeds them with jobs. 
-	*		The threads functions are defined by a lambda that is executed inside each new thread
-	*		The Queues are 3 and those are sequentially checked in decreasing order for next job to be executed
-	*
-	* @pre None
-	* @post 
-	* @param[in]  size_t threadCount - the number of threads you want to start
-	* @return None
-	*
-	* @author Atanas Rusev and Ferai Ali
-	*
-	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-	*
-	***********************************************************************************************************************/
-	void ThreadPool::impl::Init(size_t threadCount)
-	{
-		// First we explicitly initialize the 3 queues
-		m_jobsByPriority[Priority::Normal] = {};
-		m_jobsByPriority[Priority::High] = {};
-		m_jobsByPriority[Priority::Critical] = {};
-
-		// now explicitly reserve for the vector of threads the exact number of threads whished
-		m_workers.reserve(threadCount);
-
-		// this is where each thread is created to consume jobs from the queues
-		// if we have e.g. only normal jobs - and as we have multiple threads - then 
-		// we shall lock when a job is added and when a job is extracted to avoid race conditions
-		for (int i = 0; i < threadCount; i++)
-		{
-            //------------------------------------------------------------------------------------
-            // MAIN EXECUTION BLOCK of each thread 
-			//------------------------------------------------------------------------------------
-            // push back a lambda function for each thread. Capturing "this" pointer inside the lambda 
-            // function will automatically capture all the member variables for this object inside the lambda.
-            // This means the next code is executed INSIDE the corresponding thread:
-			m_workers.push_back(std::thread([this](){
-
-				// the bool m_running is initialized as true upon object creation
-                // we check it here to know when to stop consuming jobs
-				while (m_running)
-				{
-					// we create here one empty function wrapper. For std::function we have in cppreference.com:
-					/*-------------------------------------------------------------------------------------------------
-                    Class template std::function is a general-purpose polymorphic function wrapper. Instances 
-					of std::function can store, copy, and invoke any Callable target -- functions, lambda 
-					expressions, bind expressions, or other function objects, as well as pointers to member 
-					functions and pointers to data members.
-
-					The stored callable object is called the target of std::function. If a std::function contains 
-					no target, it is called empty. Invoking the target of an empty std::function results in 
-					std::bad_function_call exception being thrown.
-					---------------------------------------------------------------------------------------------------*/
-					std::function<void()> job;
-                    
-					{   // here follows the part that needs to be locked - so we create a unique_lock class object
-                        // and pass to it our mutex.
-						std::unique_lock<std::mutex> ul(m_guard);
-
-                        // once we have the lock mutex object we can wait on it via the condition variable
-                        // wait causes the current thread to block until the condition variable is 
-                        // notified or a spurious wakeup occurs, optionally looping until some predicate is satisfied. 
-                        // in our case we wait on the lambda return result. We pass again "this" to capture the member variables
-                        // for this object inside the lambda
-						// the template for wait accepts a mutex AND a predicate. If the wait should be continued - the 
-						// predicate (i.e. th lambda) shall return false
-						m_cvSleepCtrl.wait(ul, [this](){
-
-							// if the flag is set to false explicitly stop processing jobs from the queue
-							if (false == m_running)
-							{
-								return true;
-							}
-
-                            // the given thread loops here through all queues
-							bool allQueuesEmpty = true;
-							for (const auto& kvp : m_jobsByPriority) // kvp - acronym for Key-Value pair
-							{
-								allQueuesEmpty &= kvp.second.empty();
-							}
-							// we return here the result - if all queues ARE EMPTY we return false and the 
-							// condition variable will continue waiting
-							return !allQueuesEmpty;
-						});
-
-						// once we are done waiting - we loop through a Key-Value Pair based on priority to get
-						// next job from the Queues. Remember - those are sorted in descending order upon map creation!
-						for (auto& kvp : m_jobsByPriority)
-						{
-							auto& jobs = kvp.second; // we take here the Queue based on the Priority
-							if (jobs.empty())		// if the current Queue is empty - we go the next Queue
-							{
-								continue;
-							}
-							job = std::move(jobs.front()); // once we know the current queue has a job we move it
-							jobs.pop();						// and we pop one element from this Queue
-							break;		
-						}
-					}
-
-					// and finally we execute the job
-					if (job != nullptr)
-					{
-						job();
-					}
-				}
-			}));
-		}
-	}
-
-	/***********************************************************************************************************************
-	* @brief explicitly shutdown the threads - call this obligatory when wanting the threads to be stopped.
-	* 
-	* @details	Currently this is performed in the destructor relieving the user from the need to call it himself!
-	*	Once the function is called - each thread will finish it's current job and will not take a new one.
-	*	Calling it in the destructor means we will perform it exactly at program termination.
-	*	And of course it is expected, that then we have waited all future objects to be consumed, 
-	*	and so it is both safe and thread exit is correctly and undoubtedly waited at program termination.
-	*	
-	* @pre None
-	* @post None
-	* @param[in]  None
-	* @param[out]  None
-	* @return None
-	*	
-	* @author Atanas Rusev and Ferai Ali
-	*
-	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-	*
-	***********************************************************************************************************************/
-	void ThreadPool::impl::Shutdown()
-	{
-		// set the global flag for disabling any thread to continue extracting jobs and execute the main loop code
-		m_running = false;
-
-		// now notify all threads (effectively waking them up) so that they either execute their last job 
-		// and/or directly stop working as the main flag is false
-		m_cvSleepCtrl.notify_all();
-
-		// finally join all threads to ensure all of them are waited to finish before destroying the thread pool
-		for (auto& worker : m_workers)
-		{
-			if (worker.joinable())
-			{
-				worker.join();
-			}
-		}
-	}
-
-
-	/***********************************************************************************************************************
-	* @brief explicitly shutdown the threads - call this obligatory when wanting the threads to be stopped.
-	*
-	* @details	Currently this is performed in the destructor relieving the user from the need to call it himself!
-	*	Once the function is called - each thread will finish it's current job and will not take a new one.
-	*	Calling it in the destructor means we will perform it exactly at program termination.
-	*	And of course it is expected, that then we have waited all future objects to be consumed,
-	*	and so it is both safe and thread exit is correctly and undoubtedly waited at program termination.
-	*
-	* @pre None
-	* @post None
-	* @param[in]  None
-	* @param[out]  None
-	* @return None
-	*
-	* @author Atanas Rusev and Ferai Ali
-	*
-	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
-	*
-	***********************************************************************************************************************/
-	void ThreadPool::impl::AddJob(std::function<void()>&& job, Priority priority)
-	{
-		// first we lock our "one single common" thread pool mutex to ensure no overlapping (race condition)
-		// at job addition
-		std::unique_lock<std::mutex> ul(m_guard);
-
-		// then we add the new job
-		m_jobsByPriority[priority].emplace(std::move(job));
-		
-		// finally we notify at least one thread
-		m_cvSleepCtrl.notify_one();
-	}
-} //end of namespace CTP
+/***********************************************************************************************************************
+* @file thread_pool.cpp
+*
+* @brief Template based Thread Pool - the Pimpl concept implementation. It accepts 3 types of jobs by priority.
+*
+* @details	 This Thread pool is created as a class with template based functions to ensure
+*	different possible input job types - a lambda, a class method, a functor or a function.
+*
+*	It is based on the Pimpl paradigm:
+*	"Pointer to implementation" or "pImpl" is a C++ programming technique[1] that removes
+*  implementation details of a class from its object representation by placing them in a
+*  separate class, accessed through an opaque pointer
+*
+*  The jobs insertion and extraction is kept safe via one single mutex to avoid race conditions.
+*
+*  The Queues are 3 - Critical (2), High (1), and Normal(0) Priority
+*
+*  Each Thread sequentially checks the Queues from a map of Key-Value Pairs - a pair fo the priority and
+*  an element from a vector of threads.
+*
+*  Once all queues are empty - the current thread is blocked until notified via an event count (event_count.h).
+*  An atomic counter of the pending jobs tells the thread if there is anything to do without any lock, and a
+*  thread adding a job makes a wake up system call only if some thread really sleeps.
+*
+*  With the LockFreeRing queue backend the shared queues are bounded lock free rings instead, so adding and
+*  extracting a job does not take the mutex. When a ring is full the job goes to a locked overflow queue, and
+*  the later jobs of the same priority follow it there until the overflow queue is empty again.
+*
+*  In WorkStealing mode each thread additionally owns one Chase-Lev deque per priority. A job scheduled from
+*  inside a running job is pushed to the deque of the current thread without any lock. Jobs scheduled from
+*  outside of the pool still go to the shared queues. A thread without work looks for a job in the order:
+*  own deque, shared queue, deques of the other threads - for each priority from Critical down to Normal.
+*  The other threads are tried nearest first - SMT siblings, then the threads sharing the L3 cache, then the
+*  socket - so that a stolen job finds its data in a cache close by. Unpinned threads are tried in random order.
+*
+*  In NUMA mode (ThreadPoolOptions::numaPartitioned) the threads are grouped by NUMA node, and each node has
+*  shared queues of its own. A job goes to the node given as a hint, else to the node of the thread adding it.
+*  The threads of a node take the jobs of the other nodes only when their own node has none left.
+*
+*  An elastic pool (ThreadPoolOptions::maxThreadCount) has a slot for each of its possible threads from the start,
+*  so the threads never see the vector of workers change. A supervisor thread starts the thread of a free slot when
+*  the queued jobs stop making progress, and a thread beyond threadCount leaves its slot after keepAlive without jobs.
+*  With hill climbing the supervisor instead sets a target thread count from the measured throughput (see
+*  hill_climbing.h) - the threads above the target leave after their current job.
+*
+*  With lazy start (ThreadPoolOptions::lazyStart) the constructor starts no thread at all. A job which finds no
+*  sleeping thread to wake up starts the thread of the next free slot, up to threadCount - or Prewarm starts all.
+*
+*  A thread of the pool which waits for a result inside a job (ThreadPool::Wait, CTP::Future, the parallel loops)
+*  does not sleep but executes queued jobs meanwhile - see RunPendingJob.
+*
+*  The memory a job needs on its way - its node in a deque, the blocks of the locked queues and the shared state
+*  of its future - comes from per thread free lists (slab_allocator.h) and is recycled after the job. Once the
+*  pool has seen its highest load, scheduling and completing a job allocates nothing from the system.
+*
+*  There is a shutdown function which ensures all threads will stop taking new jobs based on a boolean flag.
+*  It is called in the destructor. It will join all threads and wait for the end of each of them to execute
+*  and exit.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "thread_pool.h"
+#include "adaptive_spin.h"
+#include "cpu_topology.h"
+#include "event_count.h"
+#include "hill_climbing.h"
+#include "mpmc_ring_buffer.h"
+#include "scratch_arena.h"
+#include "slab_allocator.h"
+#include "work_stealing_deque.h"
+#include "worker_thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <thread>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CTP
+{
+	// the number of priority levels - Normal, High and Critical
+	static const size_t PRIORITY_LEVELS = 3;
+
+	//-----------------------------------------------------------------------------
+	/// Thread Pool Implementation
+	//-----------------------------------------------------------------------------
+	class ThreadPool::impl
+	{
+	public:
+		// the main function for initializing the pool and starting the threads
+		void Init(const ThreadPoolOptions& options);
+
+		// explicitly shutdown the threads - call this obligatory when wanting
+		// the threads to be stopped. Currently this is performed
+		// in the destructor relieving the user from the need to call it himself!
+		void Shutdown();
+
+		// the AddJob function takes an Rvalue (double reference) to a Job object.
+		// This Job object contains a Callable that returns no result and takes no arguments
+		// The job goes to the given node - or to the node of the calling thread for ANY_NODE.
+		void AddJob(Job&& job, Priority priority, size_t node);
+
+		// adds count jobs of the same priority with one single lock (or ring reservation) and one wake up
+		void AddJobs(Job* jobs, size_t count, Priority priority);
+
+		// executes one queued job if the calling thread belongs to this pool
+		bool RunPendingJob();
+
+		// true if the calling thread belongs to this pool
+		bool IsWorkerThread() const;
+
+		// the number of slots in m_workers
+		size_t GetWorkerSlotCount() const;
+
+		// the scratch arena of the calling thread, null for a thread outside of the pool
+		ScratchArena* GetScratchArena() const;
+
+		// the CPU of each thread - NO_CPU if not pinned
+		std::vector<int> GetWorkerCpus() const;
+
+		// the stack of each thread, as the system reports it
+		std::vector<WorkerStack> GetWorkerStacks() const;
+
+		// the counters of all threads summed up
+		ThreadPoolStats GetStats() const;
+
+		// the number of nodes - 1 unless the pool is NUMA partitioned on a machine with several NUMA nodes
+		size_t GetNodeCount() const;
+
+		// the node of each thread
+		std::vector<size_t> GetWorkerNodes() const;
+
+		// the number of threads of the pool
+		size_t GetThreadCount() const;
+
+		// starts all threads of a lazy pool which are not running yet
+		void Prewarm();
+
+		// the link of the pool, shared with its futures
+		const std::shared_ptr<PoolLink>& GetLink() const
+		{
+			return m_link;
+		}
+
+	private:
+		// the threads at the same distance from a thief - these are tried in random order
+		struct VictimGroup
+		{
+			StealDistance distance;
+			std::vector<size_t> workers;
+		};
+
+		// everything a single thread of the pool owns. The deques are used only in WorkStealing mode
+		struct Worker
+		{
+			explicit Worker(size_t scratchChunkSize)
+				: scratch(scratchChunkSize)
+			{
+			}
+
+			WorkerThread thread;
+			WorkStealingDeque<Job> localJobs[PRIORITY_LEVELS];
+
+			// state of a simple xorshift generator used to pick the first victim when stealing
+			uint32_t victimSeed = 0;
+
+			// the other threads grouped by their distance to this one, nearest first - the steal order
+			std::vector<VictimGroup> victimGroups;
+
+			// the jobs this thread stole, by StealDistance. Written only by the thread itself
+			std::atomic<uint64_t> steals[STEAL_DISTANCE_COUNT];
+
+			// the spin time of the thread when it runs out of jobs - used only with IdlePolicy::SpinThenPark
+			AdaptiveSpin idleSpin;
+
+			// the CPU the thread is pinned to, NO_CPU if it is not pinned
+			std::atomic<int> cpu{ NO_CPU };
+
+			// the CPU chosen for the thread by the affinity policy - the thread is pinned to it on each start
+			int targetCpu = NO_CPU;
+
+			// true from the start of the thread until it leaves RunWorker - a slot of an elastic pool is free
+			// again after its thread has retired
+			std::atomic<bool> running{ false };
+
+			// the jobs executed by this thread. Written only by the thread itself
+			std::atomic<uint64_t> jobsExecuted{ 0 };
+
+			// the index of the node of the thread in m_nodes
+			size_t node = 0;
+
+			// the stack size and the guard size the thread really got - 0 until the slot gets its first thread
+			std::atomic<size_t> stackSize{ 0 };
+			std::atomic<size_t> guardSize{ 0 };
+
+			// the scratch memory of the jobs of this thread - rewound after each job. Used only by the thread itself
+			ScratchArena scratch;
+		};
+
+		// a locked queue of jobs. Its blocks come from the free lists of slab_allocator.h - a std::deque frees a
+		// block each time the jobs move past it and allocates a new one at the other end
+		typedef std::deque<Job, SlabAllocator<Job>> JobQueue;
+
+		// the shared queues of one NUMA node - there is only one node unless the pool is NUMA partitioned.
+		// In NUMA mode each node and the workers of the node are allocated by a thread running on the node, so
+		// that Linux places their memory - the rings and the deques - on the node (first touch).
+		struct Node
+		{
+			// guard is a mutex that is used while adding a job or extracting one from the locked queues,
+			// so that there are no race conditions.
+			std::mutex guard;
+
+			// a map of kvp - Key-Value Pair. The pair is the priority level together with it's
+			// corresponding dedicated Queue. This means for each priority we have a separate Queue
+			// the last part - std::greater<Priority> - sorts the map in descending order based on the Priority!
+			// The queues are double ended, as a thread waiting inside a job takes the newest job (see RunPendingJob).
+			std::map<Priority, JobQueue, std::greater<Priority> > jobsByPriority;
+
+			// LockFreeRing backend only: one ring per priority and the overflow queues for the jobs which do not
+			// fit in the rings. The overflow queues are guarded by their own mutex, so they never block on guard.
+			std::unique_ptr<MpmcRingBuffer<Job>> ringJobs[PRIORITY_LEVELS];
+			JobQueue overflowJobs[PRIORITY_LEVELS];
+			std::mutex overflowGuard;
+
+			// the number of jobs in each overflow queue. While the overflow queue of a priority holds jobs, the new
+			// jobs of this priority queue up behind them instead of going to the ring (see PushSharedJob)
+			std::atomic<size_t> overflowCount[PRIORITY_LEVELS]{};
+
+			// the number of jobs in the locked queues - jobsByPriority or the overflow queues - so that the
+			// threads can skip the mutex when these are empty
+			std::atomic<size_t> sharedJobCount{ 0 };
+
+			// the threads of this node without jobs sleep on this
+			EventCount idleWorkers;
+		};
+
+		// allocates the node with the given index, its queues and its workers
+		void CreateNode(size_t index, const std::vector<size_t>& workers, const ThreadPoolOptions& options);
+
+		// sorts the other threads of each thread into its victim groups - by the CPUs the threads are pinned to
+		void BuildVictimGroups(const std::vector<int>& cpus);
+
+		// starts the thread of the given slot and pins it
+		void StartWorker(size_t index);
+
+		// starts the thread of a free slot of an elastic pool. Returns false if all slots are in use
+		bool StartIdleWorker();
+
+		// lazy start: starts up to count threads while the pool has fewer than threadCount running
+		void StartLazyWorkers(size_t count);
+
+		// the main loop of the supervisor thread of an elastic pool - adds a thread whenever the jobs stall
+		void RunSupervisor();
+
+		// the main loop of the supervisor with hill climbing - sets the target thread count by the throughput
+		void RunHillClimbing();
+
+		// called by a thread between two jobs - true if it may exit as the pool has more threads than the target
+		bool TryLeave();
+
+		// the jobs executed by all threads so far
+		uint64_t CountExecutedJobs() const;
+
+		// called by a thread which found no job for the keep alive time - true if it may exit
+		bool TryRetire();
+
+		// counts one executed job for the given thread
+		void CountExecutedJob(size_t index);
+
+		// the main loop of each thread
+		void RunWorker(size_t index);
+
+		// looks for a job for the given thread - own deques, shared queues, other deques. With newest set
+		// the locked shared queues give their newest job instead of the oldest one
+		bool FindJob(size_t index, Job& job, bool newest = false);
+
+		// the search of FindJob without the pending jobs counter - the own node first, then the other nodes
+		bool TakeJob(size_t index, Job& job, bool newest);
+
+		// looks for a job on one node - in the own deques, the shared queues of the node and the deques of the
+		// threads of the node
+		bool TakeNodeJob(size_t index, size_t node, Job& job, bool newest);
+
+		// pushes a job to the shared queue of the given priority
+		void PushSharedJob(Node& node, size_t level, Job&& job);
+
+		// pushes count jobs to the shared queue of the given priority at once
+		void PushSharedJobs(Node& node, size_t level, Job* jobs, size_t count);
+
+		// pops a job from the shared queue of the given priority. Returns false if it is empty
+		bool PopSharedJob(Node& node, size_t level, Job& job, bool newest);
+
+		// tries to steal a job of the given priority from the threads of the node - nearest first
+		bool StealJob(size_t index, size_t node, size_t level, Job& job);
+
+		// the node a job added with the given hint goes to
+		size_t SelectNode(size_t hint);
+
+		// true if any shared queue or any deque contains a job - one atomic load
+		bool HasPendingJobs() const;
+
+		// wakes up to count sleeping threads if there are any - of the given node first. Returns the number of
+		// threads which may have been woken up
+		size_t WakeWorkers(size_t node, size_t count);
+
+		// executes a job and passes an exception escaping it to the exception handler
+		void RunJob(size_t index, Job& job);
+
+		// this flag is used to control the main loop in the Init function. While it is true the cycle will continue
+		// popping jobs out from the queue.
+		// Initialized as true so that once Init is called the Thread Pool is operational.
+		std::atomic<bool> m_running{ true };
+
+		// the way of the futures to this pool - cleared at the end of Shutdown
+		std::shared_ptr<PoolLink> m_link;
+
+		SchedulerMode m_schedulerMode = SchedulerMode::SharedQueue;
+		ExceptionHandler m_exceptionHandler;
+		WorkerHook m_onWorkerStart;
+		WorkerHook m_onWorkerStop;
+		QueueBackend m_queueBackend = QueueBackend::Locked;
+		IdlePolicy m_idlePolicy = IdlePolicy::Park;
+
+		// the vector of threads which will process the jobs - one slot for each thread an elastic pool may have
+		std::vector<std::unique_ptr<Worker>> m_workers;
+
+		// the threads running at the moment, and the number the pool never goes below - once started
+		std::atomic<size_t> m_activeWorkers{ 0 };
+		size_t m_minWorkers = 0;
+
+		// the threads are started by the first jobs, not by Init
+		bool m_lazyStart = false;
+
+		// the stack of each thread - see ThreadPoolOptions::stackSize
+		size_t m_stackSize = 0;
+		size_t m_guardSize = 0;
+
+		// elastic sizing - see ThreadPoolOptions::maxThreadCount
+		size_t m_growQueueDepth = 0;
+		std::chrono::milliseconds m_growDelay{ 0 };
+		std::chrono::milliseconds m_keepAlive{ 0 };
+		std::atomic<uint64_t> m_threadsAdded{ 0 };
+		std::atomic<uint64_t> m_threadsRetired{ 0 };
+
+		// hill climbing - see ThreadPoolOptions::hillClimbing. The decisions are published for GetStats
+		bool m_hillClimbing = false;
+		std::chrono::milliseconds m_tuningInterval{ 0 };
+		std::atomic<size_t> m_targetWorkers{ 0 };
+		std::atomic<double> m_throughput{ 0 };
+		std::atomic<ThreadCountDecision> m_lastDecision{ ThreadCountDecision::None };
+		std::atomic<uint64_t> m_threadCountChanges{ 0 };
+
+		// starting a thread takes this - the supervisor and Shutdown may both touch the std::thread objects
+		std::mutex m_startGuard;
+
+		// the supervisor thread of an elastic pool sleeps on this between its checks
+		std::thread m_supervisor;
+		std::mutex m_supervisorGuard;
+		std::condition_variable m_cvSupervisor;
+
+		// NUMA mode only: the CPUs of each node - a thread without a CPU of its own is pinned to these
+		std::vector<std::vector<int>> m_nodeCpus;
+
+		// the shared queues - one node, or one per NUMA node in NUMA mode
+		std::vector<std::unique_ptr<Node>> m_nodes;
+
+		// NUMA mode only: the node of each CPU number, to find the node of a thread adding a job
+		std::vector<size_t> m_cpuNodes;
+
+		// NUMA mode only: the node for the next job if the node of the adding thread is not known
+		std::atomic<size_t> m_nextNode{ 0 };
+
+		// the number of jobs in all queues and deques - incremented after a job is added, decremented after it is
+		// taken. It may be off for a moment (even negative), but never 0 while a job waits and a thread sleeps
+		std::atomic<int64_t> m_pendingJobs{ 0 };
+	};
+
+	//-----------------------------------------------------------------------------
+	/// The link of the futures to their pool - see future.h.
+	//
+	// A future calls into the pool only through the link. It counts itself as a user first
+	// and reads the pool then, while Clear sets the pool to null first and waits for
+	// the users then - so once Clear returns nobody is inside the pool any more, and
+	// nobody enters it again. A user does not stay long: Clear is called after all
+	// threads of the pool have been joined, and the calls of a thread outside of the
+	// pool (adding a job, checking the calling thread) do not block.
+	//-----------------------------------------------------------------------------
+	class PoolLink
+	{
+	public:
+		explicit PoolLink(ThreadPool::impl* pool)
+			: m_pool(pool)
+			, m_users(0)
+		{
+		}
+
+		// adds the job to the pool - or destroys it if the pool has shut down, which sets broken_promise in its future
+		void AddJob(Job&& job, Priority priority)
+		{
+			{
+				UserScope scope(m_users);
+				if (ThreadPool::impl* pool = m_pool.load())
+				{
+					pool->AddJob(std::move(job), priority, ANY_NODE);
+					return;
+				}
+			}
+			Job dropped(std::move(job));
+		}
+
+		bool IsWorkerThread() const
+		{
+			UserScope scope(m_users);
+			ThreadPool::impl* pool = m_pool.load();
+			return nullptr != pool && pool->IsWorkerThread();
+		}
+
+		bool RunPendingJob()
+		{
+			UserScope scope(m_users);
+			ThreadPool::impl* pool = m_pool.load();
+			return nullptr != pool && pool->RunPendingJob();
+		}
+
+		// called by the pool at the end of Shutdown - the futures do not reach it any more from then on
+		void Clear()
+		{
+			m_pool.store(nullptr);
+			while (0 != m_users.load())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+	private:
+		struct UserScope
+		{
+			explicit UserScope(std::atomic<size_t>& users)
+				: m_users(users)
+			{
+				m_users.fetch_add(1);
+			}
+
+			~UserScope()
+			{
+				m_users.fetch_sub(1);
+			}
+
+			std::atomic<size_t>& m_users;
+		};
+
+		std::atomic<ThreadPool::impl*> m_pool;
+		mutable std::atomic<size_t> m_users;
+	};
+
+	thread_local ThreadPool::impl* ThreadPool::s_currentPool = nullptr;
+	thread_local size_t ThreadPool::s_currentWorker = 0;
+
+	// The Constructor simply initializes a single pointer based on the template from the header file in the member:
+	// std::unique_ptr<impl> m_impl;
+	ThreadPool::ThreadPool(size_t threadCount)
+		: m_impl(std::make_unique<ThreadPool::impl>())
+	{
+		// the only functionality of the Constructor us to call the Init which effectively starts the threads
+		// you can of course add more functionality here
+		ThreadPoolOptions options;
+		options.threadCount = threadCount;
+		m_impl->Init(options);
+	}
+
+	ThreadPool::ThreadPool(const ThreadPoolOptions& options)
+		: m_impl(std::make_unique<ThreadPool::impl>())
+	{
+		m_impl->Init(options);
+	}
+
+	ThreadPool::ThreadPool(ThreadCountPreset preset)
+		: ThreadPool(ThreadPoolOptions::FromPreset(preset))
+	{
+	}
+
+	ThreadPoolOptions ThreadPoolOptions::FromPreset(ThreadCountPreset preset)
+	{
+		ThreadPoolOptions options;
+		if (ThreadCountPreset::HardwareConcurrency == preset)
+		{
+			return options;
+		}
+
+		const CpuTopology topology = CpuTopology::Discover();
+		std::vector<int> cpus = ThreadCountPreset::PhysicalCoresOnly == preset
+			? topology.GetPhysicalCoreCpus() : topology.GetL3Cpus();
+
+		// a cgroup quota below the number of cores - more threads would only be throttled
+		const size_t defaultCount = GetDefaultThreadCount().count;
+		if (cpus.size() > defaultCount)
+		{
+			cpus.resize(defaultCount);
+		}
+		if (!cpus.empty())
+		{
+			options.threadCount = cpus.size();
+			options.affinity = AffinityPolicy::Explicit(cpus);
+		}
+		return options;
+	}
+
+	// Destructor
+	ThreadPool::~ThreadPool()
+	{
+		// Via a call to Shutdown(): Simply notify all threads to finish their work by waking them up.
+		// In addition the boolean flag that controlls the execution of the threads is set to false.
+		// A moved-from pool has no implementation any more - there is nothing to shut down.
+		if (m_impl)
+		{
+			m_impl->Shutdown();
+		}
+	}
+
+	ThreadPool::ThreadPool(ThreadPool&&) = default;
+
+	ThreadPool& ThreadPool::operator=(ThreadPool&& other)
+	{
+		if (this != &other)
+		{
+			if (m_impl)
+			{
+				m_impl->Shutdown();
+			}
+			m_impl = std::move(other.m_impl);
+		}
+		return *this;
+	}
+
+	void ThreadPool::AddJob(Job&& job, Priority priority, size_t node)
+	{
+		m_impl->AddJob(std::move(job), priority, node);
+	}
+
+	void ThreadPool::AddJobs(Job* jobs, size_t count, Priority priority)
+	{
+		m_impl->AddJobs(jobs, count, priority);
+	}
+
+	const std::shared_ptr<PoolLink>& ThreadPool::GetLink() const
+	{
+		return m_impl->GetLink();
+	}
+
+	void PostContinuation(PoolLink& link, Job&& job, Priority priority)
+	{
+		link.AddJob(std::move(job), priority);
+	}
+
+	bool IsWorkerThread(const ThreadPool& pool)
+	{
+		return pool.IsWorkerThread();
+	}
+
+	bool IsWorkerThread(const PoolLink& link)
+	{
+		return link.IsWorkerThread();
+	}
+
+	bool RunPendingJob(ThreadPool& pool)
+	{
+		return pool.RunPendingJob();
+	}
+
+	bool RunPendingJob(PoolLink& link)
+	{
+		return link.RunPendingJob();
+	}
+
+	bool ThreadPool::RunPendingJob()
+	{
+		return m_impl->RunPendingJob();
+	}
+
+	bool ThreadPool::IsWorkerThread() const
+	{
+		return m_impl->IsWorkerThread();
+	}
+
+	size_t ThreadPool::GetWorkerSlotCount() const
+	{
+		return m_impl->GetWorkerSlotCount();
+	}
+
+	ScratchArena* ThreadPool::GetScratchArena() const
+	{
+		return m_impl->GetScratchArena();
+	}
+
+	std::vector<int> ThreadPool::GetWorkerCpus() const
+	{
+		return m_impl->GetWorkerCpus();
+	}
+
+	std::vector<WorkerStack> ThreadPool::GetWorkerStacks() const
+	{
+		return m_impl->GetWorkerStacks();
+	}
+
+	size_t ThreadPool::GetThreadCount() const
+	{
+		return m_impl->GetThreadCount();
+	}
+
+	void ThreadPool::Prewarm()
+	{
+		m_impl->Prewarm();
+	}
+
+	size_t ThreadPool::GetNodeCount() const
+	{
+		return m_impl->GetNodeCount();
+	}
+
+	std::vector<size_t> ThreadPool::GetWorkerNodes() const
+	{
+		return m_impl->GetWorkerNodes();
+	}
+
+	ThreadPoolStats ThreadPool::GetStats() const
+	{
+		return m_impl->GetStats();
+	}
+
+	/***********************************************************************************************************************
+	* @brief The main function for initializing the pool and starting the threads.
+	*
+	* @details	This is the main function that starts the threads and feeds them with jobs.
+	*		The threads functions are defined by a lambda that is executed inside each new thread
+	*		The Queues are 3 and those are sequentially checked in decreasing order for next job to be executed
+	*
+	* @pre None
+	* @post
+	* @param[in]  const ThreadPoolOptions& options - the number of threads you want to start and the scheduler mode
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::Init(const ThreadPoolOptions& options)
+	{
+		m_link = std::make_shared<PoolLink>(this);
+		m_schedulerMode = options.schedulerMode;
+		m_queueBackend = options.queueBackend;
+		m_exceptionHandler = options.exceptionHandler;
+		m_onWorkerStart = options.onWorkerStart;
+		m_onWorkerStop = options.onWorkerStop;
+		m_idlePolicy = options.idlePolicy;
+
+		// threadCount 0 is the default count - the cgroup files are read here only, once per pool
+		const size_t threadCount = 0 == options.threadCount ? GetDefaultThreadCount().count : options.threadCount;
+
+		// an elastic pool gets all its slots now - only threadCount of them get a thread
+		const size_t slotCount = options.maxThreadCount > threadCount ? options.maxThreadCount : threadCount;
+		m_minWorkers = threadCount;
+		m_growQueueDepth = options.growQueueDepth;
+		m_growDelay = options.growDelay;
+		m_keepAlive = options.keepAlive;
+		m_hillClimbing = options.hillClimbing && slotCount > threadCount;
+		m_tuningInterval = options.tuningInterval;
+		m_targetWorkers = threadCount;
+		m_lazyStart = options.lazyStart;
+		m_stackSize = options.stackSize;
+		m_guardSize = options.guardSize;
+
+		const std::vector<int> cpus = MapThreadsToCpus(options.affinity, slotCount);
+
+		// the node of each thread - all on node 0, unless the pool is NUMA partitioned on a machine with several
+		// nodes. A pinned thread belongs to the node of its CPU, the others are spread round robin
+		std::vector<size_t> workerNodes(slotCount, 0);
+		m_nodeCpus.resize(1);
+		if (options.numaPartitioned)
+		{
+			const CpuTopology topology = CpuTopology::Discover();
+			if (topology.GetNodeCount() > 1)
+			{
+				m_nodeCpus.resize(topology.GetNodeCount());
+				for (size_t node = 0; node < m_nodeCpus.size(); node++)
+				{
+					m_nodeCpus[node] = topology.GetNodeCpus(node);
+				}
+				for (const auto& cpu : topology.GetCpus())
+				{
+					if (static_cast<size_t>(cpu.cpu) >= m_cpuNodes.size())
+					{
+						m_cpuNodes.resize(cpu.cpu + 1, 0);
+					}
+					m_cpuNodes[cpu.cpu] = cpu.node;
+				}
+				for (size_t i = 0; i < slotCount; i++)
+				{
+					const bool pinned = NO_CPU != cpus[i] && static_cast<size_t>(cpus[i]) < m_cpuNodes.size();
+					workerNodes[i] = pinned ? m_cpuNodes[cpus[i]] : i % m_nodeCpus.size();
+				}
+			}
+		}
+
+		// now explicitly create the exact number of workers whished, node by node.
+		// All workers are created before the first thread starts, as in WorkStealing mode each thread
+		// accesses the deques of all the others.
+		m_workers.resize(slotCount);
+		m_nodes.resize(m_nodeCpus.size());
+		for (size_t node = 0; node < m_nodeCpus.size(); node++)
+		{
+			std::vector<size_t> workers;
+			for (size_t i = 0; i < slotCount; i++)
+			{
+				if (node == workerNodes[i])
+				{
+					workers.push_back(i);
+				}
+			}
+
+			if (m_nodeCpus.size() > 1)
+			{
+				// allocate from a thread running on the node - its memory is then local to the node
+				std::thread allocator([this, node, &workers, &options]()
+				{
+					PinCurrentThread(m_nodeCpus[node]);
+					CreateNode(node, workers, options);
+				});
+				allocator.join();
+			}
+			else
+			{
+				CreateNode(node, workers, options);
+			}
+		}
+		for (size_t i = 0; i < slotCount; i++)
+		{
+			m_workers[i]->targetCpu = cpus[i];
+		}
+		BuildVictimGroups(cpus);
+
+		// this is where each thread is created to consume jobs from the queues
+		// if we have e.g. only normal jobs - and as we have multiple threads - then
+		// we shall lock when a job is added and when a job is extracted to avoid race conditions
+		// with lazy start the first jobs start the threads - see StartLazyWorkers
+		if (!m_lazyStart)
+		{
+			try
+			{
+				std::unique_lock<std::mutex> ul(m_startGuard);
+				for (size_t i = 0; i < threadCount; i++)
+				{
+					StartWorker(i);
+				}
+			}
+			catch (...)
+			{
+				// a thread could not be started - the ones started already are stopped before the pool goes away
+				Shutdown();
+				throw;
+			}
+		}
+
+		if (slotCount > threadCount)
+		{
+			m_supervisor = std::thread([this]()
+			{
+				if (m_hillClimbing)
+				{
+					RunHillClimbing();
+				}
+				else
+				{
+					RunSupervisor();
+				}
+			});
+		}
+	}
+
+	/***********************************************************************************************************************
+	* @brief Starts the thread of one slot.
+	*
+	* @details	The thread of a slot which has retired before has already left RunWorker - joining it waits at most
+	*	for its onWorkerStop hook.
+	*	The threads are pinned from here and not by themselves, so that GetWorkerCpus is exact once the constructor
+	*	returns. A thread may run its first instructions unpinned - this does not matter. In NUMA mode a thread
+	*	without a CPU of its own may still run only on the CPUs of its node.
+	*
+	* @pre m_startGuard is locked
+	* @post None
+	* @param[in]  size_t index - the slot in m_workers
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::StartWorker(size_t index)
+	{
+		Worker& worker = *m_workers[index];
+		if (worker.thread.IsJoinable())
+		{
+			worker.thread.Join();
+		}
+
+		worker.running = true;
+		m_activeWorkers.fetch_add(1);
+
+		//------------------------------------------------------------------------------------
+		// MAIN EXECUTION BLOCK of each thread
+		//------------------------------------------------------------------------------------
+		// Capturing "this" pointer inside the lambda function will automatically capture all the member
+		// variables for this object inside the lambda. This means the next code is executed INSIDE the
+		// corresponding thread:
+		try
+		{
+			worker.thread.Start([this, index](){
+
+				s_currentPool = this;
+				s_currentWorker = index;
+
+				// the hooks run outside of the loop - they cost nothing per job
+				if (m_onWorkerStart)
+				{
+					m_onWorkerStart(index);
+				}
+
+				RunWorker(index);
+
+				if (m_onWorkerStop)
+				{
+					m_onWorkerStop(index);
+				}
+			}, m_stackSize, m_guardSize);
+		}
+		catch (...)
+		{
+			// e.g. a stack size the system refuses - the slot stays free
+			worker.running = false;
+			m_activeWorkers.fetch_sub(1);
+			throw;
+		}
+
+		size_t stackSize = 0;
+		size_t guardSize = 0;
+		if (worker.thread.GetStack(stackSize, guardSize))
+		{
+			worker.stackSize = stackSize;
+			worker.guardSize = guardSize;
+		}
+
+		if (NO_CPU != worker.targetCpu && worker.thread.Pin(std::vector<int>(1, worker.targetCpu)))
+		{
+			worker.cpu = worker.targetCpu;
+		}
+		else if (m_nodeCpus.size() > 1)
+		{
+			worker.thread.Pin(m_nodeCpus[worker.node]);
+		}
+	}
+
+	bool ThreadPool::impl::StartIdleWorker()
+	{
+		std::unique_lock<std::mutex> ul(m_startGuard);
+		if (!m_running)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			if (!m_workers[i]->running)
+			{
+				StartWorker(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::impl::StartLazyWorkers(size_t count)
+	{
+		// all threads have been started long ago in the common case - no lock for that
+		if (m_activeWorkers.load(std::memory_order_relaxed) >= m_minWorkers)
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> ul(m_startGuard);
+		for (size_t i = 0; i < m_workers.size() && count > 0 && m_running; i++)
+		{
+			if (m_activeWorkers.load() >= m_minWorkers)
+			{
+				break;
+			}
+			if (!m_workers[i]->running)
+			{
+				StartWorker(i);
+				count--;
+			}
+		}
+	}
+
+	void ThreadPool::impl::Prewarm()
+	{
+		StartLazyWorkers(m_minWorkers);
+	}
+
+	/***********************************************************************************************************************
+	* @brief The main loop of the supervisor thread of an elastic pool.
+	*
+	* @details	Every growDelay the supervisor compares the executed jobs with the jobs which were pending at the
+	*	previous check. If fewer jobs were executed, at least one of them has waited for the whole period - the
+	*	threads do not keep up, e.g. because they block in their jobs. If more than growQueueDepth jobs wait as well,
+	*	one thread is added. Adding at most one thread per period keeps a short burst from starting all of them.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::RunSupervisor()
+	{
+		int64_t pendingBefore = 0;
+		uint64_t executedBefore = 0;
+
+		std::unique_lock<std::mutex> ul(m_supervisorGuard);
+		while (m_running)
+		{
+			m_cvSupervisor.wait_for(ul, m_growDelay);
+
+			const uint64_t executed = CountExecutedJobs();
+			const int64_t pending = m_pendingJobs.load();
+
+			const bool stalled = pendingBefore > 0 && executed - executedBefore < static_cast<uint64_t>(pendingBefore);
+			if (m_running && stalled && pending > static_cast<int64_t>(m_growQueueDepth) && StartIdleWorker())
+			{
+				m_threadsAdded.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			pendingBefore = pending;
+			executedBefore = executed;
+		}
+	}
+
+	/***********************************************************************************************************************
+	* @brief The main loop of the supervisor thread with hill climbing.
+	*
+	* @details	Every tuningInterval the jobs completed since the last step give the throughput, and the controller
+	*	(see hill_climbing.h) chooses the thread count for the next interval. Missing threads are started right away.
+	*	Surplus threads leave after their current job (see TryLeave) - a running job is never interrupted.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::RunHillClimbing()
+	{
+		HillClimbing controller(m_minWorkers, m_workers.size());
+		uint64_t executedBefore = CountExecutedJobs();
+		auto before = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> ul(m_supervisorGuard);
+		while (m_running)
+		{
+			m_cvSupervisor.wait_for(ul, m_tuningInterval);
+			if (!m_running)
+			{
+				break;
+			}
+
+			const uint64_t executed = CountExecutedJobs();
+			const auto now = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration<double>(now - before).count();
+			const double throughput = seconds > 0 ? (executed - executedBefore) / seconds : 0;
+			executedBefore = executed;
+			before = now;
+
+			const size_t threads = m_activeWorkers.load();
+			const size_t target = controller.Update(threads, throughput, HasPendingJobs());
+			m_targetWorkers = target;
+			m_throughput.store(throughput, std::memory_order_relaxed);
+			m_lastDecision.store(controller.GetLastDecision(), std::memory_order_relaxed);
+			if (target != threads)
+			{
+				m_threadCountChanges.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			while (m_activeWorkers.load() < target && StartIdleWorker())
+			{
+				m_threadsAdded.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool ThreadPool::impl::TryLeave()
+	{
+		size_t active = m_activeWorkers.load(std::memory_order_relaxed);
+		while (active > m_targetWorkers.load(std::memory_order_relaxed) && active > m_minWorkers)
+		{
+			if (m_activeWorkers.compare_exchange_weak(active, active - 1))
+			{
+				m_threadsRetired.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint64_t ThreadPool::impl::CountExecutedJobs() const
+	{
+		uint64_t executed = 0;
+		for (const auto& worker : m_workers)
+		{
+			executed += worker->jobsExecuted.load(std::memory_order_relaxed);
+		}
+		return executed;
+	}
+
+	bool ThreadPool::impl::TryRetire()
+	{
+		size_t active = m_activeWorkers.load();
+		while (active > m_minWorkers)
+		{
+			if (m_activeWorkers.compare_exchange_weak(active, active - 1))
+			{
+				// a job added while the wait timed out may count on this thread to be woken up - then it stays.
+				// The wait has left the event count before this check, see EventCount::WaitFor
+				if (HasPendingJobs())
+				{
+					m_activeWorkers.fetch_add(1);
+					return false;
+				}
+				m_threadsRetired.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::impl::CountExecutedJob(size_t index)
+	{
+		auto& executed = m_workers[index]->jobsExecuted;
+		executed.store(executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void ThreadPool::impl::CreateNode(size_t index, const std::vector<size_t>& workers, const ThreadPoolOptions& options)
+	{
+		std::unique_ptr<Node> node(new Node());
+
+		// First we explicitly initialize the 3 queues
+		node->jobsByPriority[Priority::Normal] = JobQueue();
+		node->jobsByPriority[Priority::High] = JobQueue();
+		node->jobsByPriority[Priority::Critical] = JobQueue();
+
+		if (QueueBackend::LockFreeRing == m_queueBackend)
+		{
+			for (auto& ring : node->ringJobs)
+			{
+				ring.reset(new MpmcRingBuffer<Job>(options.ringCapacity));
+			}
+		}
+
+		for (size_t i : workers)
+		{
+			m_workers[i].reset(new Worker(options.scratchChunkSize));
+			m_workers[i]->victimSeed = static_cast<uint32_t>(i * 2654435761u + 1);
+			m_workers[i]->idleSpin = AdaptiveSpin(options.maxSpinTime);
+			m_workers[i]->node = index;
+		}
+		m_nodes[index] = std::move(node);
+	}
+
+	// the distance between two CPUs - how close the caches they share are
+	static StealDistance GetStealDistance(const CpuTopology& topology, int first, int second)
+	{
+		const LogicalCpu* a = nullptr;
+		const LogicalCpu* b = nullptr;
+		for (const auto& cpu : topology.GetCpus())
+		{
+			a = first == cpu.cpu ? &cpu : a;
+			b = second == cpu.cpu ? &cpu : b;
+		}
+
+		if (nullptr == a || nullptr == b)
+		{
+			return StealDistance::Unknown;
+		}
+		if (a->core == b->core)
+		{
+			return StealDistance::SameCore;
+		}
+		if (a->l3Domain == b->l3Domain)
+		{
+			return StealDistance::SameL3;
+		}
+		return a->socket == b->socket ? StealDistance::SameSocket : StealDistance::OtherSocket;
+	}
+
+	/***********************************************************************************************************************
+	* @brief Builds the steal order of each thread from the CPU topology.
+	*
+	* @details	The CPUs are the ones the threads are going to be pinned to - the groups are built before the threads
+	*	start, as the threads read them without any lock. Two threads pinned to the same CPU count as SMT siblings.
+	*	A thread which is not pinned is at an unknown distance from all others - without pinning there is one single
+	*	group and the steal order is random, the same as without a topology.
+	*
+	* @pre All workers are created, no thread is running yet
+	* @post None
+	* @param[in]  const std::vector<int>& cpus - the CPU of each thread, NO_CPU if it is not pinned
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::BuildVictimGroups(const std::vector<int>& cpus)
+	{
+		bool pinned = false;
+		for (int cpu : cpus)
+		{
+			pinned = pinned || NO_CPU != cpu;
+		}
+		const CpuTopology topology = pinned ? CpuTopology::Discover() : CpuTopology();
+
+		for (size_t thief = 0; thief < m_workers.size(); thief++)
+		{
+			std::vector<size_t> byDistance[STEAL_DISTANCE_COUNT];
+			for (size_t victim = 0; victim < m_workers.size(); victim++)
+			{
+				if (victim == thief)
+				{
+					continue;
+				}
+				const bool known = NO_CPU != cpus[thief] && NO_CPU != cpus[victim];
+				const StealDistance distance = known
+					? GetStealDistance(topology, cpus[thief], cpus[victim]) : StealDistance::Unknown;
+				byDistance[static_cast<size_t>(distance)].push_back(victim);
+			}
+
+			Worker& worker = *m_workers[thief];
+			for (size_t distance = 0; distance < STEAL_DISTANCE_COUNT; distance++)
+			{
+				worker.steals[distance] = 0;
+				if (!byDistance[distance].empty())
+				{
+					VictimGroup group;
+					group.distance = static_cast<StealDistance>(distance);
+					group.workers = std::move(byDistance[distance]);
+					worker.victimGroups.push_back(std::move(group));
+				}
+			}
+		}
+	}
+
+	size_t ThreadPool::impl::GetThreadCount() const
+	{
+		// a lazy pool counts the threads it is going to start as well
+		const size_t active = m_activeWorkers.load(std::memory_order_relaxed);
+		return active > m_minWorkers ? active : m_minWorkers;
+	}
+
+	/***********************************************************************************************************************
+	* @brief The main loop of each thread.
+	*
+	* @details	The thread executes jobs as long as it finds any - in its own deques, in the shared queues or in the
+	*		deques of the other threads, for each priority from Critical down to Normal. Only when there is no job
+	*		anywhere it goes to sleep on the event count of its node. After announcing it sleeps it checks the pending jobs
+	*		counter once more - a job added meanwhile either is seen here or its Notify wakes the thread up.
+	*		With IdlePolicy::SpinThenPark the thread first spins for a while - see adaptive_spin.h. The length of
+	*		each idle period is then measured to tune the spin time. A thread of an elastic pool which sleeps for
+	*		keepAlive while the pool has more than threadCount threads leaves the loop - see TryRetire.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  size_t index - the index of the thread in m_workers
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::RunWorker(size_t index)
+	{
+		Worker& self = *m_workers[index];
+		Node& node = *m_nodes[self.node];
+		const bool spin = IdlePolicy::SpinThenPark == m_idlePolicy;
+
+		// the start of the current idle period - only measured with spinning
+		bool idle = false;
+		AdaptiveSpin::Clock::time_point idleSince;
+
+		while (m_running)
+		{
+			// the hill climbing has lowered the thread count - this thread is one too many
+			if (m_hillClimbing && TryLeave())
+			{
+				break;
+			}
+
+			Job job;
+			if (FindJob(index, job))
+			{
+				if (idle)
+				{
+					self.idleSpin.RecordIdleTime(AdaptiveSpin::Clock::now() - idleSince);
+					idle = false;
+				}
+				RunJob(index, job);
+				CountExecutedJob(index);
+				continue;
+			}
+
+			if (spin)
+			{
+				if (!idle)
+				{
+					idle = true;
+					idleSince = AdaptiveSpin::Clock::now();
+				}
+				if (self.idleSpin.Spin(idleSince, [this]() { return !m_running || HasPendingJobs(); }))
+				{
+					continue;
+				}
+			}
+
+			// announce the sleep first, then check again - either the thread adding a job sees us in the event
+			// count or we see its job here (see event_count.h)
+			const EventCount::Key key = node.idleWorkers.PrepareWait();
+			if (!m_running || HasPendingJobs())
+			{
+				node.idleWorkers.CancelWait();
+				continue;
+			}
+
+			// a thread of an elastic pool above its minimum leaves after keepAlive without any job
+			if (m_activeWorkers.load(std::memory_order_relaxed) <= m_minWorkers)
+			{
+				node.idleWorkers.Wait(key);
+			}
+			else if (!node.idleWorkers.WaitFor(key, m_keepAlive) && TryRetire())
+			{
+				break;
+			}
+		}
+
+		// a retired thread gives its scratch memory back - the next thread of the slot may need less
+		self.scratch.Release();
+
+		// the slot may get a new thread from now on
+		self.running = false;
+	}
+
+	bool ThreadPool::impl::FindJob(size_t index, Job& job, bool newest)
+	{
+		// nothing anywhere - no need to look into each queue and deque
+		if (!HasPendingJobs() || !TakeJob(index, job, newest))
+		{
+			return false;
+		}
+		m_pendingJobs.fetch_sub(1);
+		return true;
+	}
+
+	bool ThreadPool::impl::TakeJob(size_t index, Job& job, bool newest)
+	{
+		const size_t own = m_workers[index]->node;
+		if (TakeNodeJob(index, own, job, newest))
+		{
+			return true;
+		}
+
+		// nothing left on the own node - only now the jobs of the other nodes are taken
+		for (size_t i = 1; i < m_nodes.size(); i++)
+		{
+			if (TakeNodeJob(index, (own + i) % m_nodes.size(), job, newest))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ThreadPool::impl::TakeNodeJob(size_t index, size_t nodeIndex, Job& job, bool newest)
+	{
+		Worker& self = *m_workers[index];
+		Node& node = *m_nodes[nodeIndex];
+		const bool workStealing = SchedulerMode::WorkStealing == m_schedulerMode;
+		const bool ownNode = nodeIndex == self.node;
+
+		// for each priority from Critical down to Normal: own deque, shared queue, deques of the others
+		for (size_t level = PRIORITY_LEVELS; level-- > 0;)
+		{
+			if (workStealing && ownNode)
+			{
+				Job* local = self.localJobs[level].Pop();
+				if (local != nullptr)
+				{
+					job = std::move(*local);
+					delete local;
+					return true;
+				}
+			}
+
+			if (PopSharedJob(node, level, job, newest))
+			{
+				return true;
+			}
+
+			if (workStealing && StealJob(index, nodeIndex, level, job))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ThreadPool::impl::PushSharedJob(Node& node, size_t level, Job&& job)
+	{
+		if (QueueBackend::LockFreeRing == m_queueBackend)
+		{
+			// the workers empty the ring before they look at the overflow queue. A job which goes to the ring
+			// while older jobs of the same priority wait in the overflow queue would overtake them, and a steady
+			// stream of such jobs would starve them. So the ring is used only while the overflow queue is empty
+			if (0 == node.overflowCount[level].load(std::memory_order_acquire) &&
+				node.ringJobs[level]->TryPush(std::move(job)))
+			{
+				return;
+			}
+
+			std::unique_lock<std::mutex> ul(node.overflowGuard);
+			auto& overflow = node.overflowJobs[level];
+			// the overflow queue may have been emptied in the meantime - then the ring is tried once more
+			if (overflow.empty() && node.ringJobs[level]->TryPush(std::move(job)))
+			{
+				return;
+			}
+			overflow.emplace_back(std::move(job));
+			node.overflowCount[level].fetch_add(1);
+			node.sharedJobCount.fetch_add(1);
+			return;
+		}
+
+		std::unique_lock<std::mutex> ul(node.guard);
+		node.jobsByPriority[static_cast<Priority>(level)].emplace_back(std::move(job));
+		node.sharedJobCount.fetch_add(1);
+	}
+
+	void ThreadPool::impl::PushSharedJobs(Node& node, size_t level, Job* jobs, size_t count)
+	{
+		if (QueueBackend::LockFreeRing == m_queueBackend)
+		{
+			// the same as in PushSharedJob - the ring is used only while the overflow queue is empty
+			size_t pushed = 0;
+			if (0 == node.overflowCount[level].load(std::memory_order_acquire))
+			{
+				pushed = node.ringJobs[level]->TryPushBulk(jobs, count);
+				if (pushed == count)
+				{
+					return;
+				}
+			}
+
+			// the rest goes to the overflow queue under one lock
+			std::unique_lock<std::mutex> ul(node.overflowGuard);
+			auto& overflow = node.overflowJobs[level];
+			if (overflow.empty())
+			{
+				pushed += node.ringJobs[level]->TryPushBulk(jobs + pushed, count - pushed);
+			}
+			for (size_t i = pushed; i < count; i++)
+			{
+				overflow.emplace_back(std::move(jobs[i]));
+			}
+			node.overflowCount[level].fetch_add(count - pushed);
+			node.sharedJobCount.fetch_add(count - pushed);
+			return;
+		}
+
+		std::unique_lock<std::mutex> ul(node.guard);
+		auto& queue = node.jobsByPriority[static_cast<Priority>(level)];
+		for (size_t i = 0; i < count; i++)
+		{
+			queue.emplace_back(std::move(jobs[i]));
+		}
+		node.sharedJobCount.fetch_add(count);
+	}
+
+	bool ThreadPool::impl::PopSharedJob(Node& node, size_t level, Job& job, bool newest)
+	{
+		if (QueueBackend::LockFreeRing == m_queueBackend && node.ringJobs[level]->TryPop(job))
+		{
+			return true;
+		}
+
+		// the counter is only a hint, but it saves the mutex in the common case of empty locked queues
+		if (0 == node.sharedJobCount.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		const bool ring = QueueBackend::LockFreeRing == m_queueBackend;
+		std::unique_lock<std::mutex> ul(ring ? node.overflowGuard : node.guard);
+		auto& jobs = ring ? node.overflowJobs[level] : node.jobsByPriority[static_cast<Priority>(level)];
+		if (jobs.empty())
+		{
+			return false;
+		}
+		if (newest)
+		{
+			job = std::move(jobs.back());
+			jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		if (ring)
+		{
+			node.overflowCount[level].fetch_sub(1, std::memory_order_relaxed);
+		}
+		node.sharedJobCount.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool ThreadPool::impl::StealJob(size_t index, size_t node, size_t level, Job& job)
+	{
+		Worker& self = *m_workers[index];
+		for (const auto& group : self.victimGroups)
+		{
+			// start from a random victim so that the thieves do not all hammer the same thread
+			uint32_t& seed = self.victimSeed;
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+
+			const size_t victimCount = group.workers.size();
+			const size_t first = seed % victimCount;
+			for (size_t i = 0; i < victimCount; i++)
+			{
+				Worker& victim = *m_workers[group.workers[(first + i) % victimCount]];
+				if (victim.node != node)
+				{
+					continue;
+				}
+
+				Job* stolen = victim.localJobs[level].Steal();
+				if (stolen != nullptr)
+				{
+					job = std::move(*stolen);
+					delete stolen;
+
+					// only this thread writes its counters - no read-modify-write needed
+					auto& steals = self.steals[static_cast<size_t>(group.distance)];
+					steals.store(steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/***********************************************************************************************************************
+	* @brief Chooses the node for a new job.
+	*
+	* @details	A job without a hint stays on the node of the thread adding it - this is where its data was most
+	*	probably just written. For a thread of the pool this is the node of the thread, for any other thread the
+	*	node of the CPU it runs on at the moment. Only if this is not known the nodes take turns.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  size_t hint - the node given with the job, ANY_NODE if none. Taken modulo the node count
+	* @return size_t - the index of the node in m_nodes
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	size_t ThreadPool::impl::SelectNode(size_t hint)
+	{
+		const size_t nodeCount = m_nodes.size();
+		if (1 == nodeCount)
+		{
+			return 0;
+		}
+		if (ANY_NODE != hint)
+		{
+			return hint % nodeCount;
+		}
+		if (this == s_currentPool)
+		{
+			return m_workers[s_currentWorker]->node;
+		}
+
+		const int cpu = GetCurrentCpu();
+		if (NO_CPU != cpu && static_cast<size_t>(cpu) < m_cpuNodes.size())
+		{
+			return m_cpuNodes[cpu];
+		}
+		return m_nextNode.fetch_add(1, std::memory_order_relaxed) % nodeCount;
+	}
+
+	bool ThreadPool::impl::HasPendingJobs() const
+	{
+		return m_pendingJobs.load() > 0;
+	}
+
+	size_t ThreadPool::impl::WakeWorkers(size_t node, size_t count)
+	{
+		// the counter is incremented before this call - see RunWorker and event_count.h.
+		// The threads of the node come first - the other nodes help only with their idle threads, for the jobs
+		// the node cannot take right now
+		size_t woken = m_nodes[node]->idleWorkers.Notify(count);
+		for (size_t i = 1; i < m_nodes.size() && woken < count; i++)
+		{
+			woken += m_nodes[(node + i) % m_nodes.size()]->idleWorkers.Notify(count - woken);
+		}
+		return woken;
+	}
+
+	bool ThreadPool::impl::IsWorkerThread() const
+	{
+		return this == s_currentPool;
+	}
+
+	size_t ThreadPool::impl::GetWorkerSlotCount() const
+	{
+		return m_workers.size();
+	}
+
+	ScratchArena* ThreadPool::impl::GetScratchArena() const
+	{
+		return this == s_currentPool ? &m_workers[s_currentWorker]->scratch : nullptr;
+	}
+
+	ThreadPoolStats ThreadPool::impl::GetStats() const
+	{
+		ThreadPoolStats stats;
+		stats.threadCount = m_activeWorkers.load(std::memory_order_relaxed);
+		stats.threadsAdded = m_threadsAdded.load(std::memory_order_relaxed);
+		stats.threadsRetired = m_threadsRetired.load(std::memory_order_relaxed);
+		stats.targetThreadCount = m_hillClimbing ? m_targetWorkers.load(std::memory_order_relaxed) : 0;
+		stats.throughput = m_throughput.load(std::memory_order_relaxed);
+		stats.lastDecision = m_lastDecision.load(std::memory_order_relaxed);
+		stats.threadCountChanges = m_threadCountChanges.load(std::memory_order_relaxed);
+		for (const auto& worker : m_workers)
+		{
+			stats.jobsExecuted += worker->jobsExecuted.load(std::memory_order_relaxed);
+			for (size_t distance = 0; distance < STEAL_DISTANCE_COUNT; distance++)
+			{
+				stats.steals[distance] += worker->steals[distance].load(std::memory_order_relaxed);
+			}
+		}
+		return stats;
+	}
+
+	size_t ThreadPool::impl::GetNodeCount() const
+	{
+		return m_nodes.size();
+	}
+
+	std::vector<size_t> ThreadPool::impl::GetWorkerNodes() const
+	{
+		std::vector<size_t> nodes;
+		nodes.reserve(m_workers.size());
+		for (const auto& worker : m_workers)
+		{
+			nodes.push_back(worker->node);
+		}
+		return nodes;
+	}
+
+	std::vector<WorkerStack> ThreadPool::impl::GetWorkerStacks() const
+	{
+		std::vector<WorkerStack> stacks;
+		stacks.reserve(m_workers.size());
+		for (const auto& worker : m_workers)
+		{
+			WorkerStack stack;
+			stack.stackSize = worker->stackSize;
+			stack.guardSize = worker->guardSize;
+			stacks.push_back(stack);
+		}
+		return stacks;
+	}
+
+	std::vector<int> ThreadPool::impl::GetWorkerCpus() const
+	{
+		std::vector<int> cpus;
+		cpus.reserve(m_workers.size());
+		for (const auto& worker : m_workers)
+		{
+			cpus.push_back(worker->cpu);
+		}
+		return cpus;
+	}
+
+	/***********************************************************************************************************************
+	* @brief Executes one queued job on the calling thread, if it is a thread of this pool.
+	*
+	* @details	Used by a thread which waits for a result inside a job (see ThreadPool::Wait). The job is found as in
+	*	the main loop - highest priority first - with one difference: from the locked shared queues the newest job
+	*	is taken. Each executed job nests on the stack of the waiting thread, and the newest jobs are most probably
+	*	the ones the waiting job has just added itself. Taking the oldest job instead makes the nesting grow with
+	*	the number of queued jobs. The lock free ring can only give its oldest job, so for deeply recursive waits
+	*	the WorkStealing mode (where the own deque is used LIFO) is the better choice.
+	*
+	*	The job is executed even after Shutdown has started, so that a job which waits for other jobs can still
+	*	finish and the thread can be joined.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @return bool - true if a job was executed
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	bool ThreadPool::impl::RunPendingJob()
+	{
+		if (!IsWorkerThread())
+		{
+			return false;
+		}
+
+		Job job;
+		if (!FindJob(s_currentWorker, job, true))
+		{
+			return false;
+		}
+
+		RunJob(s_currentWorker, job);
+		CountExecutedJob(s_currentWorker);
+		return true;
+	}
+
+	void ThreadPool::impl::RunJob(size_t index, Job& job)
+	{
+		// a job run while another job of this thread waits (see RunPendingJob) frees only its own scratch memory
+		ScratchArena& scratch = m_workers[index]->scratch;
+		const ScratchArena::Marker marker = scratch.GetMarker();
+
+		// Schedule, ScheduleBatch and ScheduleAsync (with its continuations) store the exception of the callable in
+		// the future. Anything else a job throws arrives here - from the jobs of Post and PostBatch, which have no
+		// future, and from any job which throws outside of a future, e.g. a continuation whose result cannot be stored
+		try
+		{
+			job();
+		}
+		catch (...)
+		{
+			if (!m_exceptionHandler)
+			{
+				std::terminate();
+			}
+			m_exceptionHandler(std::current_exception());
+		}
+		scratch.Rewind(marker);
+	}
+
+	/***********************************************************************************************************************
+	* @brief explicitly shutdown the threads - call this obligatory when wanting the threads to be stopped.
+	*
+	* @details	Currently this is performed in the destructor relieving the user from the need to call it himself!
+	*	Once the function is called - each thread will finish it's current job and will not take a new one.
+	*	Calling it in the destructor means we will perform it exactly at program termination.
+	*	And of course it is expected, that then we have waited all future objects to be consumed,
+	*	and so it is both safe and thread exit is correctly and undoubtedly waited at program termination.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  None
+	* @param[out]  None
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::Shutdown()
+	{
+		// set the global flag for disabling any thread to continue extracting jobs and execute the main loop code.
+		m_running = false;
+
+		// the supervisor may be starting a thread right now - it is stopped first, so that nothing starts after
+		{
+			std::unique_lock<std::mutex> ul(m_supervisorGuard);
+			m_cvSupervisor.notify_all();
+		}
+		if (m_supervisor.joinable())
+		{
+			m_supervisor.join();
+		}
+
+		// a job adding a job may be starting a thread of a lazy pool - once it is done, none starts any more
+		{
+			std::unique_lock<std::mutex> ul(m_startGuard);
+		}
+
+		// now notify all threads (effectively waking them up) so that they either execute their last job
+		// and/or directly stop working as the main flag is false. A thread about to sleep checks the flag after
+		// announcing itself in the event count, so it cannot miss this.
+		for (auto& node : m_nodes)
+		{
+			node->idleWorkers.NotifyAll();
+		}
+
+		// finally join all threads to ensure all of them are waited to finish before destroying the thread pool
+		for (auto& worker : m_workers)
+		{
+			if (worker->thread.IsJoinable())
+			{
+				worker->thread.Join();
+			}
+		}
+
+		// the jobs left in the deques are never executed - release them
+		for (auto& worker : m_workers)
+		{
+			for (auto& deque : worker->localJobs)
+			{
+				while (Job* job = deque.Pop())
+				{
+					delete job;
+				}
+			}
+		}
+
+		// the same for the shared queues. They are emptied here, while the pool is still whole, and not by their
+		// destructors: a dropped job sets broken_promise in its future, which may add the continuations of the
+		// future - AddJob destroys those right away. The jobs are destroyed outside of the locks for that reason
+		for (auto& node : m_nodes)
+		{
+			std::vector<Job> dropped;
+			{
+				std::unique_lock<std::mutex> ul(node->guard);
+				for (auto& kvp : node->jobsByPriority)
+				{
+					std::move(kvp.second.begin(), kvp.second.end(), std::back_inserter(dropped));
+					kvp.second.clear();
+				}
+			}
+			{
+				std::unique_lock<std::mutex> ul(node->overflowGuard);
+				for (auto& queue : node->overflowJobs)
+				{
+					std::move(queue.begin(), queue.end(), std::back_inserter(dropped));
+					queue.clear();
+				}
+				for (auto& count : node->overflowCount)
+				{
+					count.store(0);
+				}
+			}
+			for (auto& ring : node->ringJobs)
+			{
+				Job job;
+				while (ring && ring->TryPop(job))
+				{
+					dropped.push_back(std::move(job));
+				}
+			}
+			dropped.clear();
+		}
+
+		// the futures which outlive the pool must not reach it any more
+		if (m_link)
+		{
+			m_link->Clear();
+		}
+	}
+
+
+	/***********************************************************************************************************************
+	* @brief Adds a job to the queue of the given priority and wakes up a thread to process it.
+	*
+	* @details	In WorkStealing mode a job scheduled by one of the threads of this pool goes to the deque of this
+	*	thread and no lock is taken. All other jobs go to the shared queue of their priority - under the mutex
+	*	for the Locked backend, lock free for the LockFreeRing backend. A wake up system call is made only if a
+	*	thread sleeps - with all threads busy adding a job costs no system call at all. In NUMA mode the job goes
+	*	to the node chosen by SelectNode, and stays in the deque of the thread only if this is on that node.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  Job&& job - the job to be executed
+	* @param[in]  Priority priority - the priority of the job
+	* @param[in]  size_t node - the node hint, ANY_NODE for the node of the calling thread
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::AddJob(Job&& job, Priority priority, size_t node)
+	{
+		// after Shutdown no thread would ever execute the job, e.g. a continuation of a job dropped by Shutdown.
+		// It is destroyed right away, so that its future gets broken_promise instead of waiting forever
+		if (!m_running)
+		{
+			job.Reset();
+			return;
+		}
+
+		const size_t level = static_cast<size_t>(priority);
+		const size_t target = SelectNode(node);
+		if (SchedulerMode::WorkStealing == m_schedulerMode && this == s_currentPool
+			&& target == m_workers[s_currentWorker]->node)
+		{
+			m_workers[s_currentWorker]->localJobs[level].Push(new Job(std::move(job)));
+		}
+		else
+		{
+			PushSharedJob(*m_nodes[target], level, std::move(job));
+		}
+
+		// count the job first, then wake up one thread if any sleeps
+		m_pendingJobs.fetch_add(1);
+		if (0 == WakeWorkers(target, 1) && m_lazyStart)
+		{
+			StartLazyWorkers(1);
+		}
+	}
+
+	/***********************************************************************************************************************
+	* @brief Adds a batch of jobs of the same priority at once.
+	*
+	* @details	The jobs are added with one single lock of the mutex - or one reservation in the lock free ring, or
+	*	without any lock into the deque of the current thread in WorkStealing mode. Then up to count sleeping
+	*	threads are woken up with one single system call.
+	*
+	* @pre None
+	* @post None
+	* @param[in]  Job* jobs - the jobs to be executed. Those are moved out of the array
+	* @param[in]  size_t count - the number of jobs in the array
+	* @param[in]  Priority priority - the priority of all the jobs
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void ThreadPool::impl::AddJobs(Job* jobs, size_t count, Priority priority)
+	{
+		if (0 == count)
+		{
+			return;
+		}
+		if (!m_running)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				jobs[i].Reset();
+			}
+			return;
+		}
+
+		const size_t level = static_cast<size_t>(priority);
+		const size_t target = SelectNode(ANY_NODE);
+		if (SchedulerMode::WorkStealing == m_schedulerMode && this == s_currentPool)
+		{
+			auto& deque = m_workers[s_currentWorker]->localJobs[level];
+			for (size_t i = 0; i < count; i++)
+			{
+				deque.Push(new Job(std::move(jobs[i])));
+			}
+		}
+		else
+		{
+			PushSharedJobs(*m_nodes[target], level, jobs, count);
+		}
+
+		m_pendingJobs.fetch_add(count);
+		const size_t woken = WakeWorkers(target, count);
+		if (woken < count && m_lazyStart)
+		{
+			StartLazyWorkers(count - woken);
+		}
+	}
+} //end of namespace CTP
@@ -1,120 +1,921 @@
-/***********************************************************************************************************************
-* @file thread_pool.h
-*
-* @brief Template based Thread Pool with Pimpl concept implementation. It accepts 3 types of jobs by priority.
-*
-* @details	 This Thread pool is created as a class with template based functions to ensure
-*	different possible input job types - a lambda, a class method, or a function.
-*
-*	It is based on the Pimpl paradigm:
-*	"Pointer to implementation" or "pImpl" is a C++ programming technique[1] that removes
-*  implementation details of a class from its object representation by placing them in a
-*  separate class, accessed through an opaque pointer
-*
-*  The Queues are 3 - Critical (2), High (1), and Normal(0) Priority
-*
-*
-*
-*  The code is based completely on C++11 features. The purpose is to be able to integrate it
-*  in older projects which have not yet reached C++14 or higher. If you need newer features
-*  fork the code and get it to the next level yourself.
-*
-* @author Atanas Rusev and Ferai Ali
-*
-* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
-*
-***********************************************************************************************************************/
-#pragma once
-#ifndef CTP_THREAD_POOL_H
-#define CTP_THREAD_POOL_H
-
-#include <future>
-#include <functional>
-
-namespace CTP
-{
-	template<typename F, typename... Args>
-	using JobReturnType = typename std::result_of<F(Args...)>::type;
-
-	// this is the priority of the jobs. Most jobs shall be ran as Normal priority. 
-	enum class Priority : size_t
-	{
-		Normal,
-		High,
-		Critical
-	};
-
-	class ThreadPool
-	{
-	public:
-		// with this constructor we take by default the number of hardware threads possible. 
-		// pay attenttion - an Intel CPU with Hyperthreading will report double the number of HW cores
-		// if you want to explicitly limit the number of threads to the number of cores and NOT use hyperthreading - 
-		// you have to write a Windows, MAC or Linux specific code!
-		ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
-		
-		// Defaulted default constructor: the compiler will define the implicit default constructor even 
-		// if other constructors are present.
-		ThreadPool(ThreadPool&&) = default;
-		ThreadPool& operator=(ThreadPool&&) = default;
-
-		~ThreadPool();
-
-		// explicitly forbid copy constructors by reference or asignment, so that the thread pool is only one!
-		ThreadPool(const ThreadPool&) = delete;
-		ThreadPool& operator=(const ThreadPool&) = delete;
-
-		//-----------------------------------------------------------------------------
-		/// Adds a job for a given priority level. Returns a future.
-		//
-		// This is a template function that takes a function of implementation defined
-		// type, hence we are freed from the necessity to define overloaded versions
-		// for different input. It is transferred as an Rvalue (double reference)
-		// The arguments are provided as variadic template args.
-		// The return type is a trailing return type. Reason - different functions may 
-		// have  different return types. In addition we recieve an std::future to be 
-		// able to get notification for the job done.
-		//-----------------------------------------------------------------------------
-		template <typename F, typename... Args>
-		auto Schedule(Priority priority, F&& f, Args&&... args)
-			->std::future<JobReturnType<F, Args...>>
-		{
-			auto job = std::make_shared<std::packaged_task<JobReturnType<F, Args...>()>>
-				(
-					std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-					);
-
-			AddJob([job] { (*job)(); }, priority);
-			return job->get_future();
-		}
-
-		//-----------------------------------------------------------------------------
-		/// Adds a job with DEFAULT priority level (Normal). Returns a future.
-		//-----------------------------------------------------------------------------
-		template <typename F, typename... Args>
-		auto Schedule(F&& f, Args&&... args)
-			->std::future<JobReturnType<F, Args...>>
-		{
-			return Schedule(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
-		}
-
-	private:
-		// internally a job is a void function with no arguments
-		// 
-		void AddJob(std::function<void()> job, Priority priority);
-
-		// we use the Pimpl technique, so we need an implementation class
-		// and a unique pointer to it. The class definition and declaration are separated from the template
-		// thus serving the Pimpl concept.
-		class impl;
-		// the pointer is based on the std::unique_ptr<...> template. This is a smart pointer that owns and 
-		// manages another object through a pointer and disposes of that object when the unique_ptr goes out of scope.
-		// The object is disposed of using the associated deleter when either of the following happens :
-		//	- the managing unique_ptr object is destroyed
-		//	- the managing unique_ptr object is assigned another pointer via operator= or reset().
-		std::unique_ptr<impl> m_impl;
-	};
-
-} // end of namespace CTP
-
-#endif CTP_THREAD_POOL_H
\ No newline at end of file
+/***********************************************************************************************************************
+* @file thread_pool.h
+*
+* @brief Template based Thread Pool with Pimpl concept implementation. It accepts 3 types of jobs by priority.
+*
+* @details	 This Thread pool is created as a class with template based functions to ensure
+*	different possible input job types - a lambda, a class method, or a function.
+*
+*	It is based on the Pimpl paradigm:
+*	"Pointer to implementation" or "pImpl" is a C++ programming technique[1] that removes
+*  implementation details of a class from its object representation by placing them in a
+*  separate class, accessed through an opaque pointer
+*
+*  The Queues are 3 - Critical (2), High (1), and Normal(0) Priority
+*
+*
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_THREAD_POOL_H
+#define CTP_THREAD_POOL_H
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "cache_aligned_array.h"
+#include "cpu_affinity.h"
+#include "future.h"
+#include "hill_climbing.h"
+#include "job.h"
+#include "parallel_range.h"
+#include "scratch_arena.h"
+#include "slab_allocator.h"
+#include "thread_count.h"
+
+namespace CTP
+{
+	template<typename F, typename... Args>
+	using JobReturnType = typename std::result_of<F(Args...)>::type;
+
+	// this is the priority of the jobs. Most jobs shall be ran as Normal priority. 
+	enum class Priority : size_t
+	{
+		Normal,
+		High,
+		Critical
+	};
+
+	// this is how the jobs are distributed between the threads. The SharedQueue is the original design and is kept
+	// as default - it is simple and fair, but every Schedule and every job extraction lock the same mutex.
+	enum class SchedulerMode : size_t
+	{
+		SharedQueue,	// one queue per priority shared by all threads, guarded by one single mutex
+		WorkStealing	// each thread owns a deque per priority. Jobs scheduled from inside a job stay on the
+						// scheduling thread, idle threads steal from the others.
+	};
+
+	// this is how the shared queues (one per priority) are stored
+	enum class QueueBackend : size_t
+	{
+		Locked,			// std::deque guarded by the one single pool mutex
+		LockFreeRing	// bounded lock free ring buffer. Jobs that do not fit go to a locked overflow queue
+	};
+
+	// this is what a thread does when it runs out of jobs
+	enum class IdlePolicy : size_t
+	{
+		Park,			// sleep on the condition variable immediately - no CPU is used while idle
+		SpinThenPark	// check the queues in a busy loop for a short, self tuning time first (see adaptive_spin.h),
+						// so a job coming soon after starts without waking the thread up. Pays off only if the
+						// threads of the pool have cores of their own - a spinning thread occupies its core
+	};
+
+	// ready made thread counts based on the CPU topology (see cpu_topology.h) - used by ThreadPoolOptions::FromPreset.
+	// Where the topology is not known all presets give the HardwareConcurrency pool. No preset has more threads than
+	// GetDefaultThreadCount() - the CPUs the process may really use (see thread_count.h)
+	enum class ThreadCountPreset : size_t
+	{
+		HardwareConcurrency,	// GetDefaultThreadCount() threads, not pinned - the default pool
+		PhysicalCoresOnly,		// one thread per physical core, pinned to the first CPU of the core - no SMT sharing
+		OneThreadPerL3			// one thread per L3 cache domain, pinned to the first CPU of the domain
+	};
+
+	// how far the thread a job was stolen from is from the thief - WorkStealing mode (see ThreadPoolStats)
+	enum class StealDistance : size_t
+	{
+		SameCore,		// an SMT sibling on the same physical core - or the same CPU
+		SameL3,			// another core sharing the L3 cache
+		SameSocket,		// another L3 domain of the same socket
+		OtherSocket,	// another socket - the data comes over the interconnect
+		Unknown			// one of the threads is not pinned to a CPU, or the topology is not known
+	};
+
+	static const size_t STEAL_DISTANCE_COUNT = 5;
+
+	// the stack of one thread in bytes, as the system reports it - 0 for a slot whose thread has not started yet
+	struct WorkerStack
+	{
+		size_t stackSize = 0;
+		size_t guardSize = 0;
+	};
+
+	// the counters of the pool. Each is read without stopping the threads - the values are only a snapshot
+	struct ThreadPoolStats
+	{
+		// the jobs the threads took from the deques of other threads, indexed by StealDistance
+		uint64_t steals[STEAL_DISTANCE_COUNT] = {};
+
+		// the jobs executed so far
+		uint64_t jobsExecuted = 0;
+
+		// the threads running now, and the threads an elastic pool has added and retired so far
+		size_t threadCount = 0;
+		uint64_t threadsAdded = 0;
+		uint64_t threadsRetired = 0;
+
+		// hill climbing only: the thread count the controller aims for, the completed jobs per second it measured
+		// last, its last decision and the number of times it changed the thread count
+		size_t targetThreadCount = 0;
+		double throughput = 0;
+		ThreadCountDecision lastDecision = ThreadCountDecision::None;
+		uint64_t threadCountChanges = 0;
+	};
+
+	// the node hint of a job which may run on any NUMA node - see ThreadPool::ScheduleOnNode
+	static const size_t ANY_NODE = static_cast<size_t>(-1);
+
+	// the thread index of a thread which does not belong to the pool - see ThreadPool::GetWorkerIndex
+	static const size_t NO_WORKER = static_cast<size_t>(-1);
+
+	// the biggest batch (ScheduleBatch, PostBatch) whose jobs are collected without the global allocator
+	static const size_t SLAB_BATCH_SIZE = MAX_SLAB_BLOCK_SIZE / sizeof(Job);
+
+	// receives the exceptions thrown by the jobs added with Post or PostBatch - these have no future to carry the
+	// exception - and by any other job which throws outside of a future.
+	// It is called on the thread which executed the job.
+	typedef std::function<void(std::exception_ptr)> ExceptionHandler;
+
+	// called on a thread of the pool when it starts or exits - receives the index of the thread (see
+	// ThreadPool::GetWorkerCpus for the indexes)
+	typedef std::function<void(size_t)> WorkerHook;
+
+	// the construction options of the thread pool. The default values give the same pool as ThreadPool()
+	struct ThreadPoolOptions
+	{
+		// 0 - the CPUs the process may use, limited by its affinity mask and the cgroup CPU quota (see
+		// thread_count.h). Resolved once when the pool starts, not for each ThreadPoolOptions
+		size_t threadCount = 0;
+		SchedulerMode schedulerMode = SchedulerMode::SharedQueue;
+		QueueBackend queueBackend = QueueBackend::Locked;
+
+		// the number of jobs each ring of the LockFreeRing backend holds (rounded up to a power of two)
+		size_t ringCapacity = 1024;
+
+		IdlePolicy idlePolicy = IdlePolicy::Park;
+
+		// SpinThenPark only: the upper limit of the spin time. Each thread spins for twice the average gap it
+		// sees between the jobs, but not longer than this - and not at all if the gaps are longer than this
+		std::chrono::microseconds maxSpinTime = std::chrono::microseconds(50);
+
+		// how the threads are pinned to CPUs - not at all by default (see cpu_affinity.h)
+		AffinityPolicy affinity;
+
+		// NUMA mode: the threads are grouped by NUMA node (see cpu_topology.h) and each node gets shared queues
+		// of its own, allocated in the memory of the node. A thread runs only on the CPUs of its node and takes
+		// jobs of other nodes only when its own node has none. Without several NUMA nodes this changes nothing
+		bool numaPartitioned = false;
+
+		// Elastic sizing: with maxThreadCount above threadCount the pool starts threadCount threads and adds more,
+		// up to maxThreadCount, while the jobs wait. Each growDelay at most one thread is added - if more than
+		// growQueueDepth jobs are queued and a job has waited for the whole growDelay. A thread which then finds
+		// no job for keepAlive exits again, but the pool never has fewer than threadCount threads.
+		// 0 - a fixed pool of threadCount threads
+		size_t maxThreadCount = 0;
+		size_t growQueueDepth = 0;
+		std::chrono::milliseconds growDelay = std::chrono::milliseconds(10);
+		std::chrono::milliseconds keepAlive = std::chrono::milliseconds(10000);
+
+		// Elastic pools only: instead of adding threads for waiting jobs, tune the thread count between threadCount
+		// and maxThreadCount by hill climbing on the completed jobs per second, measured every tuningInterval
+		// (see hill_climbing.h). The decisions are reported by ThreadPool::GetStats
+		bool hillClimbing = false;
+		std::chrono::milliseconds tuningInterval = std::chrono::milliseconds(100);
+
+		// Lazy start: the constructor starts no thread. A job which finds no sleeping thread starts one, until
+		// threadCount threads run - a short lived program scheduling a few jobs creates only the threads it needs.
+		// ThreadPool::Prewarm starts all of them at once
+		bool lazyStart = false;
+
+		// The stack size of each thread and the size of the guard area below it, in bytes - 0 keeps the default of
+		// the system, usually 8 MB of virtual memory plus one page. Pools with many threads and shallow jobs save
+		// their address space with e.g. 256 KB. The stack size is rounded up to a page and to at least
+		// PTHREAD_STACK_MIN - ThreadPool::GetWorkerStacks reports what the threads got. See worker_thread.h
+		size_t stackSize = 0;
+		size_t guardSize = 0;
+
+		// the size of the chunks of the scratch arena of each thread (see ThreadPool::GetScratchArena). A thread
+		// allocates its first chunk only when a job asks for scratch memory
+		size_t scratchChunkSize = 64 * 1024;
+
+		// the options with the thread count and the pinning of the preset - all other options are the defaults
+		static ThreadPoolOptions FromPreset(ThreadCountPreset preset);
+
+		// called for an exception escaping a job added with Post. If no handler is given such an exception
+		// calls std::terminate - the same as for an exception escaping a std::thread - it is never lost silently
+		ExceptionHandler exceptionHandler;
+
+		// Called once on each thread before its first job and once after its last job, e.g. to set the name of the
+		// thread, to warm thread local caches or to flush per thread buffers. A slot of an elastic pool
+		// calls the hooks for each thread it gets - onWorkerStop of a thread always runs before onWorkerStart of
+		// the next thread of the same slot. onWorkerStart may run before the thread is pinned (see affinity).
+		// An exception escaping a hook calls std::terminate
+		WorkerHook onWorkerStart;
+		WorkerHook onWorkerStop;
+	};
+
+	class ThreadPool
+	{
+	public:
+		// with this constructor we take by default the number of hardware threads possible - but not more than the
+		// affinity mask and the cgroup CPU quota of the process allow (GetDefaultThreadCount, see thread_count.h). 
+		// pay attenttion - an Intel CPU with Hyperthreading will report double the number of HW cores
+		// if you want to explicitly limit the number of threads to the number of cores and NOT use hyperthreading - 
+		// use the constructor with ThreadCountPreset::PhysicalCoresOnly below (Linux only, see cpu_topology.h)
+		// 0 stands for that default count
+		ThreadPool(size_t threadCount = 0);
+
+		// with this constructor all the construction options are given explicitly - e.g. the scheduler mode
+		explicit ThreadPool(const ThreadPoolOptions& options);
+
+		// the same as ThreadPool(ThreadPoolOptions::FromPreset(preset))
+		explicit ThreadPool(ThreadCountPreset preset);
+		
+		// Move constructor and move assignment. These are defined in the cpp file, where the implementation
+		// class is a complete type. The move assignment shuts down the threads of the pool being overwritten.
+		ThreadPool(ThreadPool&&);
+		ThreadPool& operator=(ThreadPool&&);
+
+		~ThreadPool();
+
+		// explicitly forbid copy constructors by reference or asignment, so that the thread pool is only one!
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job for a given priority level. Returns a future.
+		//
+		// This is a template function that takes a function of implementation defined
+		// type, hence we are freed from the necessity to define overloaded versions
+		// for different input. It is transferred as an Rvalue (double reference)
+		// The arguments are provided as variadic template args.
+		// The return type is a trailing return type. Reason - different functions may 
+		// have  different return types. In addition we recieve an std::future to be 
+		// able to get notification for the job done.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto Schedule(Priority priority, F&& f, Args&&... args)
+			->std::future<JobReturnType<F, Args...>>
+		{
+			typedef JobReturnType<F, Args...> ResultType;
+			typedef decltype(std::bind(std::forward<F>(f), std::forward<Args>(args)...)) Function;
+
+			// the promise is move only and is kept inline in the Job - no extra shared_ptr is needed. Its shared
+			// state comes from the free lists of slab_allocator.h, so in steady state nothing is allocated
+			std::promise<ResultType> promise = MakeSlabPromise<ResultType>();
+			auto result = promise.get_future();
+			AddJob(Job(PromiseTask<ResultType, Function>(std::move(promise),
+				std::bind(std::forward<F>(f), std::forward<Args>(args)...))), priority);
+			return result;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job with DEFAULT priority level (Normal). Returns a future.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto Schedule(F&& f, Args&&... args)
+			->std::future<JobReturnType<F, Args...>>
+		{
+			return Schedule(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job for a given priority level to the queues of a NUMA node. Returns a future.
+		//
+		// For a NUMA partitioned pool (see ThreadPoolOptions::numaPartitioned) - the job is
+		// executed by a thread of the given node, close to the memory of its data, unless
+		// the node is busy while another one is idle. Without NUMA mode the same as Schedule.
+		// Without a hint a job goes to the node of the thread adding it.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto ScheduleOnNode(size_t node, Priority priority, F&& f, Args&&... args)
+			->std::future<JobReturnType<F, Args...>>
+		{
+			typedef JobReturnType<F, Args...> ResultType;
+			typedef decltype(std::bind(std::forward<F>(f), std::forward<Args>(args)...)) Function;
+
+			std::promise<ResultType> promise = MakeSlabPromise<ResultType>();
+			auto result = promise.get_future();
+			AddJob(Job(PromiseTask<ResultType, Function>(std::move(promise),
+				std::bind(std::forward<F>(f), std::forward<Args>(args)...))), priority, node);
+			return result;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job with DEFAULT priority level (Normal) to the queues of a NUMA node. Returns a future.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto ScheduleOnNode(size_t node, F&& f, Args&&... args)
+			->std::future<JobReturnType<F, Args...>>
+		{
+			return ScheduleOnNode(node, Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job for a given priority level. Returns a CTP::Future (see future.h).
+		//
+		// The same as Schedule, but the returned Future can be continued without
+		// blocking any thread - with Then, WhenAll and WhenAny. The continuations are
+		// added to this pool, by default with the priority given here.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto ScheduleAsync(Priority priority, F&& f, Args&&... args)
+			->Future<JobReturnType<F, Args...>>
+		{
+			typedef JobReturnType<F, Args...> ResultType;
+			typedef decltype(std::bind(std::forward<F>(f), std::forward<Args>(args)...)) Function;
+
+			auto state = std::allocate_shared<FutureState<ResultType>>(SlabAllocator<FutureState<ResultType>>(),
+				GetLink(), priority);
+			AddJob(Job(FutureTask<ResultType, Function>(state,
+				std::bind(std::forward<F>(f), std::forward<Args>(args)...))), priority);
+			return Future<ResultType>(state);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a job with DEFAULT priority level (Normal). Returns a CTP::Future.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		auto ScheduleAsync(F&& f, Args&&... args)
+			->Future<JobReturnType<F, Args...>>
+		{
+			return ScheduleAsync(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a fire and forget job for a given priority level. Returns nothing.
+		//
+		// Unlike Schedule there is no packaged_task, no shared state and no future - the
+		// bound callable is stored directly in the Job. The result of the callable is
+		// discarded. An exception thrown by the job goes to the exceptionHandler given
+		// in the ThreadPoolOptions (or calls std::terminate when there is none).
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		void Post(Priority priority, F&& f, Args&&... args)
+		{
+			AddJob(Job(std::bind(std::forward<F>(f), std::forward<Args>(args)...)), priority);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a fire and forget job with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		void Post(F&& f, Args&&... args)
+		{
+			Post(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a fire and forget job for a given priority level to the queues of a NUMA node - see ScheduleOnNode.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		void PostOnNode(size_t node, Priority priority, F&& f, Args&&... args)
+		{
+			AddJob(Job(std::bind(std::forward<F>(f), std::forward<Args>(args)...)), priority, node);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a fire and forget job with DEFAULT priority level (Normal) to the queues of a NUMA node.
+		//-----------------------------------------------------------------------------
+		template <typename F, typename... Args>
+		void PostOnNode(size_t node, F&& f, Args&&... args)
+		{
+			PostOnNode(node, Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs for a given priority level. Returns one future per job.
+		//
+		// The callables in the range [first, last) are copied. All jobs are added with
+		// one single lock of the queue (or one single reservation in the lock free ring)
+		// and the sleeping threads are woken up only once for the whole batch.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator>
+		auto ScheduleBatch(Priority priority, Iterator first, Iterator last)
+			->std::vector<std::future<JobReturnType<typename std::iterator_traits<Iterator>::reference>>>
+		{
+			typedef JobReturnType<typename std::iterator_traits<Iterator>::reference> ResultType;
+
+			std::vector<std::future<ResultType>> results;
+			ReserveBatch(results, first, last);
+			ScheduleBatch(priority, first, last, std::back_inserter(results));
+			return results;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs for a given priority level. Writes one future per job to results.
+		//
+		// The same as above, but the futures go to an output iterator given by the caller
+		// instead of a new vector - e.g. a back inserter of a vector which is reused for
+		// every batch, so that a batch of up to SLAB_BATCH_SIZE jobs allocates nothing.
+		// Returns the output iterator past the last future.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename OutputIterator>
+		OutputIterator ScheduleBatch(Priority priority, Iterator first, Iterator last, OutputIterator results)
+		{
+			typedef JobReturnType<typename std::iterator_traits<Iterator>::reference> ResultType;
+			typedef typename std::decay<typename std::iterator_traits<Iterator>::reference>::type Function;
+
+			JobBatch jobs;
+			ReserveBatch(jobs, first, last);
+			for (; first != last; ++first)
+			{
+				std::promise<ResultType> promise = MakeSlabPromise<ResultType>();
+				*results = promise.get_future();
+				++results;
+				jobs.emplace_back(PromiseTask<ResultType, Function>(std::move(promise), Function(*first)));
+			}
+
+			AddJobs(jobs.data(), jobs.size(), priority);
+			return results;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs with DEFAULT priority level (Normal). Returns one future per job.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator>
+		auto ScheduleBatch(Iterator first, Iterator last)
+			->std::vector<std::future<JobReturnType<typename std::iterator_traits<Iterator>::reference>>>
+		{
+			return ScheduleBatch(Priority::Normal, first, last);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs with DEFAULT priority level (Normal). Writes one future per job to results.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename OutputIterator>
+		OutputIterator ScheduleBatch(Iterator first, Iterator last, OutputIterator results)
+		{
+			return ScheduleBatch(Priority::Normal, first, last, results);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs given as an initializer list for a given priority level.
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		auto ScheduleBatch(Priority priority, std::initializer_list<F> jobs)
+			->std::vector<std::future<JobReturnType<const F&>>>
+		{
+			return ScheduleBatch(priority, jobs.begin(), jobs.end());
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of jobs given as an initializer list with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		auto ScheduleBatch(std::initializer_list<F> jobs)
+			->std::vector<std::future<JobReturnType<const F&>>>
+		{
+			return ScheduleBatch(Priority::Normal, jobs.begin(), jobs.end());
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of fire and forget jobs for a given priority level - see Post.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator>
+		void PostBatch(Priority priority, Iterator first, Iterator last)
+		{
+			JobBatch jobs;
+			ReserveBatch(jobs, first, last);
+			for (; first != last; ++first)
+			{
+				jobs.emplace_back(*first);
+			}
+
+			AddJobs(jobs.data(), jobs.size(), priority);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of fire and forget jobs with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename Iterator>
+		void PostBatch(Iterator first, Iterator last)
+		{
+			PostBatch(Priority::Normal, first, last);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of fire and forget jobs given as an initializer list for a given priority level.
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		void PostBatch(Priority priority, std::initializer_list<F> jobs)
+		{
+			PostBatch(priority, jobs.begin(), jobs.end());
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Adds a batch of fire and forget jobs given as an initializer list with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		void PostBatch(std::initializer_list<F> jobs)
+		{
+			PostBatch(Priority::Normal, jobs.begin(), jobs.end());
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Calls body(i) for every i in [begin, end) in parallel. Blocks until all calls are done.
+		//
+		// The range is split in chunks with guided scheduling (see parallel_range.h):
+		// big chunks first, smaller towards the end, never below grain iterations.
+		// With grain 0 a grain is chosen from the range size and the number of threads.
+		// The calling thread processes chunks as well instead of just waiting. The first
+		// exception thrown by the body is rethrown here once the running chunks are done.
+		//-----------------------------------------------------------------------------
+		template <typename Index, typename F>
+		void ParallelFor(Priority priority, Index begin, Index end, F&& body, size_t grain = 0)
+		{
+			if (!(begin < end))
+			{
+				return;
+			}
+
+			auto chunkBody = [&body, begin](size_t chunkBegin, size_t chunkEnd, size_t)
+			{
+				for (size_t i = chunkBegin; i < chunkEnd; i++)
+				{
+					body(static_cast<Index>(begin + i));
+				}
+			};
+			RunParallel(priority, static_cast<size_t>(end - begin), grain, chunkBody);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Calls body(i) for every i in [begin, end) in parallel with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename Index, typename F>
+		void ParallelFor(Index begin, Index end, F&& body, size_t grain = 0)
+		{
+			ParallelFor(Priority::Normal, begin, end, std::forward<F>(body), grain);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Calls body(element) for every element of [first, last) in parallel - see ParallelFor.
+		/// The iterators must be random access.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename F>
+		void ParallelForEach(Priority priority, Iterator first, Iterator last, F&& body, size_t grain = 0)
+		{
+			typedef typename std::iterator_traits<Iterator>::difference_type Difference;
+
+			if (!(first < last))
+			{
+				return;
+			}
+
+			auto chunkBody = [&body, first](size_t chunkBegin, size_t chunkEnd, size_t)
+			{
+				Iterator it = first + static_cast<Difference>(chunkBegin);
+				for (size_t i = chunkBegin; i < chunkEnd; i++, ++it)
+				{
+					body(*it);
+				}
+			};
+			RunParallel(priority, static_cast<size_t>(last - first), grain, chunkBody);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Calls body(element) for every element of [first, last) in parallel with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename F>
+		void ParallelForEach(Iterator first, Iterator last, F&& body, size_t grain = 0)
+		{
+			ParallelForEach(Priority::Normal, first, last, std::forward<F>(body), grain);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Reduces transform(element) for all elements of [first, last) with reduce, starting from init.
+		//
+		// Each participant of the parallel loop (see ParallelFor) accumulates the chunks it
+		// processes in its own partial result - the partial results are on separate cache
+		// lines, so there is no false sharing and no synchronization per element. At the end
+		// the partial results are combined pairwise as a tree on the calling thread.
+		// As for std::transform_reduce, reduce must be associative and commutative - the
+		// grouping and the order of the elements are not specified.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename T, typename Reduce, typename Transform>
+		T ParallelTransformReduce(Priority priority, Iterator first, Iterator last, T init,
+			Reduce reduce, Transform transform, size_t grain = 0)
+		{
+			typedef typename std::iterator_traits<Iterator>::difference_type Difference;
+
+			if (!(first < last))
+			{
+				return init;
+			}
+
+			const size_t count = static_cast<size_t>(last - first);
+			if (0 == grain)
+			{
+				grain = DefaultGrain(count);
+			}
+			const size_t participants = ParallelParticipants(count, grain);
+
+			// the value of a partial result is meaningful only once it is valid. Until then it holds a copy of init
+			// just because T is not required to be default constructible
+			struct Partial
+			{
+				T value;
+				bool valid;
+			};
+			CacheAlignedArray<Partial> partials(participants, Partial{ init, false });
+
+			auto chunkBody = [&](size_t chunkBegin, size_t chunkEnd, size_t participant)
+			{
+				Partial& partial = partials[participant];
+				Iterator it = first + static_cast<Difference>(chunkBegin);
+				size_t i = chunkBegin;
+				if (!partial.valid)
+				{
+					partial.value = transform(*it);
+					partial.valid = true;
+					++it;
+					++i;
+				}
+
+				T accumulator = std::move(partial.value);
+				for (; i < chunkEnd; i++, ++it)
+				{
+					accumulator = reduce(std::move(accumulator), transform(*it));
+				}
+				partial.value = std::move(accumulator);
+			};
+			RunParallel(priority, count, grain, participants, chunkBody);
+
+			// tree combine of the partial results: neighbours first, then pairs of pairs and so on
+			std::vector<T> results;
+			results.reserve(participants);
+			for (size_t participant = 0; participant < participants; participant++)
+			{
+				if (partials[participant].valid)
+				{
+					results.push_back(std::move(partials[participant].value));
+				}
+			}
+			for (size_t step = 1; step < results.size(); step *= 2)
+			{
+				for (size_t i = 0; i + step < results.size(); i += 2 * step)
+				{
+					results[i] = reduce(std::move(results[i]), std::move(results[i + step]));
+				}
+			}
+			return reduce(std::move(init), std::move(results[0]));
+		}
+
+		//-----------------------------------------------------------------------------
+		/// ParallelTransformReduce with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename T, typename Reduce, typename Transform>
+		T ParallelTransformReduce(Iterator first, Iterator last, T init, Reduce reduce, Transform transform,
+			size_t grain = 0)
+		{
+			return ParallelTransformReduce(Priority::Normal, first, last, std::move(init), reduce, transform, grain);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Reduces all elements of [first, last) with reduce, starting from init - see ParallelTransformReduce.
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename T, typename Reduce>
+		T ParallelReduce(Priority priority, Iterator first, Iterator last, T init, Reduce reduce, size_t grain = 0)
+		{
+			return ParallelTransformReduce(priority, first, last, std::move(init), reduce, IdentityTransform(), grain);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// ParallelReduce with DEFAULT priority level (Normal).
+		//-----------------------------------------------------------------------------
+		template <typename Iterator, typename T, typename Reduce>
+		T ParallelReduce(Iterator first, Iterator last, T init, Reduce reduce, size_t grain = 0)
+		{
+			return ParallelReduce(Priority::Normal, first, last, std::move(init), reduce, grain);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Blocks until the future is ready. Use it instead of future.wait() inside a job.
+		//
+		// Called from a thread of this pool, it does not put the thread to sleep but keeps
+		// executing queued jobs - highest priority first - until the result is ready. So a
+		// job may wait for jobs it has scheduled itself even with a single thread, where a
+		// plain future.get() deadlocks. From any other thread it is future.wait().
+		//-----------------------------------------------------------------------------
+		template <typename T>
+		void Wait(const std::future<T>& future)
+		{
+			CooperativeWait(this,
+				[&future]() { return std::future_status::ready == future.wait_for(std::chrono::seconds(0)); },
+				[&future]() { future.wait(); },
+				[&future](std::chrono::microseconds timeout) { future.wait_for(timeout); });
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Waits for the future as Wait does and returns its result. Consumes the future.
+		//-----------------------------------------------------------------------------
+		template <typename T>
+		T Get(std::future<T>& future)
+		{
+			Wait(future);
+			return future.get();
+		}
+
+		template <typename T>
+		T Get(std::future<T>&& future)
+		{
+			Wait(future);
+			return future.get();
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Executes one queued job on the calling thread. Returns false if nothing was executed.
+		//
+		// Only a thread of this pool executes anything - called from any other thread the
+		// function returns false. The job is chosen exactly as the thread would choose
+		// its next job - from Critical down to Normal.
+		//-----------------------------------------------------------------------------
+		bool RunPendingJob();
+
+		// true if the calling thread is one of the threads of this pool
+		bool IsWorkerThread() const;
+
+		// the index of the calling thread in this pool, from 0 to GetWorkerSlotCount() - 1. NO_WORKER for a
+		// thread which does not belong to the pool. Inline - a job may call it for every update of its data
+		size_t GetWorkerIndex() const
+		{
+			return m_impl.get() == s_currentPool ? s_currentWorker : NO_WORKER;
+		}
+
+		// the number of thread indexes - threadCount, or maxThreadCount for an elastic pool. Fixed for the life
+		// of the pool, so per thread data can be allocated once (see worker_local.h)
+		size_t GetWorkerSlotCount() const;
+
+		// The scratch arena of the calling thread - null if it is not a thread of this pool. A job allocates its
+		// temporary buffers from it without any lock, and all of it is freed when the job returns (see
+		// scratch_arena.h). Nothing allocated from it may be used after the job, e.g. as its result
+		ScratchArena* GetScratchArena() const;
+
+		// the CPU each thread is pinned to, by thread index - NO_CPU for a thread which is not pinned.
+		// An elastic pool reports all its slots, up to maxThreadCount, whether they have a thread now or not.
+		// A slot is pinned only once its thread starts
+		std::vector<int> GetWorkerCpus() const;
+
+		// the stack size and the guard size of each thread, by thread index - to check ThreadPoolOptions::stackSize
+		std::vector<WorkerStack> GetWorkerStacks() const;
+
+		// the number of threads of the pool - for an elastic pool the ones running at the moment. A lazy pool
+		// counts the threads it has not started yet as well - GetStats().threadCount has the running ones only
+		size_t GetThreadCount() const;
+
+		// starts all threads of a lazy pool right now, e.g. before the first latency critical jobs.
+		// Does nothing for a pool whose threads run already
+		void Prewarm();
+
+		// the number of NUMA nodes the threads are grouped by - 1 unless the pool is NUMA partitioned
+		size_t GetNodeCount() const;
+
+		// the node of each thread, by thread index - the valid node hints are 0 to GetNodeCount() - 1
+		std::vector<size_t> GetWorkerNodes() const;
+
+		// the counters of all threads - e.g. the steals by distance
+		ThreadPoolStats GetStats() const;
+
+	private:
+		// the futures reach the pool through its link - see future.h
+		friend class PoolLink;
+
+		// the link of this pool, shared with all its futures
+		const std::shared_ptr<PoolLink>& GetLink() const;
+
+		// the jobs of a batch on their way to AddJobs. The array comes from the free lists of slab_allocator.h up
+		// to SLAB_BATCH_SIZE jobs - a bigger batch takes it from the global operator new, once for the whole batch
+		typedef std::vector<Job, SlabAllocator<Job>> JobBatch;
+
+		// reserves the size of a batch in one go, so that the vector does not grow and move its jobs again and
+		// again. Only for forward iterators - an input iterator can walk the range only once
+		template <typename Vector, typename Iterator>
+		static void ReserveBatch(Vector& vector, Iterator first, Iterator last)
+		{
+			ReserveBatch(vector, first, last, typename std::iterator_traits<Iterator>::iterator_category());
+		}
+
+		template <typename Vector, typename Iterator>
+		static void ReserveBatch(Vector& vector, Iterator first, Iterator last, std::forward_iterator_tag)
+		{
+			vector.reserve(static_cast<size_t>(std::distance(first, last)));
+		}
+
+		template <typename Vector, typename Iterator>
+		static void ReserveBatch(Vector&, Iterator, Iterator, std::input_iterator_tag)
+		{
+		}
+
+		// the transform of ParallelReduce - passes the element unchanged
+		struct IdentityTransform
+		{
+			template <typename X>
+			X&& operator()(X&& x) const
+			{
+				return std::forward<X>(x);
+			}
+		};
+
+		//-----------------------------------------------------------------------------
+		/// Processes count iterations with chunkBody(chunkBegin, chunkEnd, participant).
+		//
+		// Adds one helper job per additional participant, participates with the calling
+		// thread as participant 0 and waits for the rest. The caller may choose the number
+		// of participants itself - ParallelTransformReduce needs it to size its partial results.
+		//-----------------------------------------------------------------------------
+		template <typename ChunkBody>
+		void RunParallel(Priority priority, size_t count, size_t grain, const ChunkBody& chunkBody)
+		{
+			if (0 == grain)
+			{
+				grain = DefaultGrain(count);
+			}
+			RunParallel(priority, count, grain, ParallelParticipants(count, grain), chunkBody);
+		}
+
+		// the same with the grain and the number of participants already chosen by the caller
+		template <typename ChunkBody>
+		void RunParallel(Priority priority, size_t count, size_t grain, size_t participants,
+			const ChunkBody& chunkBody)
+		{
+			// the range and the helpers come from the free lists - a parallel loop allocates nothing in steady state
+			auto range = std::allocate_shared<ParallelRange<ChunkBody>>(SlabAllocator<ParallelRange<ChunkBody>>(),
+				count, grain, participants, chunkBody);
+
+			JobBatch helpers;
+			helpers.reserve(participants);
+			for (size_t participant = 1; participant < participants; participant++)
+			{
+				helpers.emplace_back([range, participant]() { range->Run(participant); });
+			}
+			AddJobs(helpers.data(), helpers.size(), priority);
+
+			// the chunks still in progress are being finished by the helpers - a thread of the pool executes
+			// other queued jobs meanwhile, e.g. the helpers of a nested loop
+			range->Run(0);
+			CooperativeWait(this,
+				[&range]() { return range->IsDone(); },
+				[&range]() { range->Wait(); },
+				[&range](std::chrono::microseconds timeout) { range->WaitFor(timeout); });
+			range->Rethrow();
+		}
+
+		// the grain used when the caller gives 0 - small enough for a good balance, big enough for a cheap tail
+		size_t DefaultGrain(size_t count) const
+		{
+			const size_t grain = count / (64 * (GetThreadCount() + 1));
+			return grain > 0 ? grain : 1;
+		}
+
+		// the calling thread plus at most one helper per thread, but not more than there are chunks
+		size_t ParallelParticipants(size_t count, size_t grain) const
+		{
+			const size_t chunks = (count + grain - 1) / grain;
+			const size_t participants = GetThreadCount() + 1;
+			return chunks < participants ? chunks : participants;
+		}
+
+		// internally a job is a void function with no arguments - see job.h
+		// The job goes to the given NUMA node - for ANY_NODE to the node of the calling thread
+		void AddJob(Job&& job, Priority priority, size_t node = ANY_NODE);
+
+		// adds count jobs of the same priority at once. The jobs are moved out of the array
+		void AddJobs(Job* jobs, size_t count, Priority priority);
+
+		// we use the Pimpl technique, so we need an implementation class
+		// and a unique pointer to it. The class definition and declaration are separated from the template
+		// thus serving the Pimpl concept.
+		class impl;
+
+		// the pointer is based on the std::unique_ptr<...> template. This is a smart pointer that owns and 
+		// manages another object through a pointer and disposes of that object when the unique_ptr goes out of scope.
+		// The object is disposed of using the associated deleter when either of the following happens :
+		//	- the managing unique_ptr object is destroyed
+		//	- the managing unique_ptr object is assigned another pointer via operator= or reset().
+		std::unique_ptr<impl> m_impl;
+
+		// the pool and the index of the worker which runs on the current thread. Null for non pool threads.
+		// Declared here and not in impl, so that GetWorkerIndex is inlined
+		static thread_local impl* s_currentPool;
+		static thread_local size_t s_currentWorker;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_THREAD_POOL_H
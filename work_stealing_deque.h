@@ -0,0 +1,205 @@
+/***********************************************************************************************************************
+* @file work_stealing_deque.h
+*
+* @brief Chase-Lev work stealing deque used by the worker threads of the Thread Pool in WorkStealing mode.
+*
+* @details	 Each worker thread owns one deque per priority. Only the owner pushes and pops at the bottom end,
+*	all other threads may steal from the top end. Push and Pop of the owner are wait free in the common case,
+*	Steal is lock free and only one CAS on the top index is needed to take an element.
+*
+*  The implementation follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen,
+*  Zappa Nardelli, PPoPP 2013), i.e. the C11 memory model version of the Chase-Lev deque.
+*
+*  The deque stores raw pointers - the ownership of the pointed objects is with the caller. When the circular
+*  buffer is full it is doubled. The old buffers are kept alive until the deque is destroyed, because a thief
+*  may still be reading from them - this is the simplest safe memory reclamation for this data structure.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_WORK_STEALING_DEQUE_H
+#define CTP_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace CTP
+{
+	template <typename T>
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(int64_t initialCapacity = 256)
+			: m_top(0)
+			, m_bottom(0)
+			, m_buffer(new Buffer(RoundUpToPowerOfTwo(initialCapacity)))
+		{
+			m_buffers.emplace_back(m_buffer.load(std::memory_order_relaxed));
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Pushes an element at the bottom. Only the owner thread may call this.
+		//-----------------------------------------------------------------------------
+		void Push(T* item)
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+			const int64_t top = m_top.load(std::memory_order_acquire);
+			Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+
+			// the buffer is full - double it. Only the owner ever replaces the buffer
+			if (bottom - top > buffer->capacity - 1)
+			{
+				buffer = Grow(buffer, top, bottom);
+			}
+
+			// the release store publishes the element to the thieves, which load the bottom with acquire
+			buffer->Put(bottom, item);
+			m_bottom.store(bottom + 1, std::memory_order_release);
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Pops the most recently pushed element. Only the owner thread may call this.
+		/// Returns nullptr if the deque is empty or the last element was stolen meanwhile.
+		//-----------------------------------------------------------------------------
+		T* Pop()
+		{
+			const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+			Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+			m_bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = m_top.load(std::memory_order_relaxed);
+
+			T* item = nullptr;
+			if (top <= bottom)
+			{
+				item = buffer->Get(bottom);
+				if (top == bottom)
+				{
+					// this is the last element - we race with the thieves for it
+					if (!m_top.compare_exchange_strong(top, top + 1,
+						std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						item = nullptr;
+					}
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				}
+			}
+			else
+			{
+				// the deque was already empty - restore the bottom
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Steals the oldest element. May be called from any thread.
+		/// Returns nullptr if the deque is empty or another thread won the race for the element.
+		//-----------------------------------------------------------------------------
+		T* Steal()
+		{
+			int64_t top = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+			if (top < bottom)
+			{
+				Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+				T* item = buffer->Get(top);
+				if (m_top.compare_exchange_strong(top, top + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return item;
+				}
+			}
+			return nullptr;
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Returns true if there is nothing to pop or steal. The answer may be stale when used
+		/// by a thread which is not the owner, so it is only a hint.
+		//-----------------------------------------------------------------------------
+		bool Empty() const
+		{
+			const int64_t top = m_top.load(std::memory_order_seq_cst);
+			const int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+			return bottom <= top;
+		}
+
+	private:
+		// circular array of atomic slots. The capacity is always a power of two so that the index can be masked
+		struct Buffer
+		{
+			explicit Buffer(int64_t size)
+				: capacity(size)
+				, mask(size - 1)
+				, slots(new std::atomic<T*>[static_cast<size_t>(size)])
+			{
+			}
+
+			T* Get(int64_t index) const
+			{
+				return slots[static_cast<size_t>(index & mask)].load(std::memory_order_relaxed);
+			}
+
+			void Put(int64_t index, T* item)
+			{
+				slots[static_cast<size_t>(index & mask)].store(item, std::memory_order_relaxed);
+			}
+
+			const int64_t capacity;
+			const int64_t mask;
+			std::unique_ptr<std::atomic<T*>[]> slots;
+		};
+
+		Buffer* Grow(Buffer* old, int64_t top, int64_t bottom)
+		{
+			Buffer* bigger = new Buffer(old->capacity * 2);
+			for (int64_t i = top; i < bottom; i++)
+			{
+				bigger->Put(i, old->Get(i));
+			}
+			m_buffers.emplace_back(bigger);
+			m_buffer.store(bigger, std::memory_order_release);
+			return bigger;
+		}
+
+		static int64_t RoundUpToPowerOfTwo(int64_t value)
+		{
+			int64_t result = 2;
+			while (result < value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		// top and bottom are written by different threads - keep them on separate cache lines. Explicit padding
+		// is used instead of alignas, as C++11 does not guarantee over-aligned dynamic allocation
+		static const size_t CACHE_LINE_SIZE = 64;
+
+		std::atomic<int64_t> m_top;
+		char m_topPadding[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+		std::atomic<int64_t> m_bottom;
+		char m_bottomPadding[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+		std::atomic<Buffer*> m_buffer;
+
+		// all buffers ever used - owned here and freed only when the deque is destroyed
+		std::vector<std::unique_ptr<Buffer>> m_buffers;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_WORK_STEALING_DEQUE_H
@@ -0,0 +1,166 @@
+/***********************************************************************************************************************
+* @file worker_local.h
+*
+* @brief One instance of a value per thread of the Thread Pool, merged at the end - lock free accumulation.
+*
+* @details	 Jobs which collect results (counters, histograms, partial sums, lists of found items) otherwise lock a
+*	shared container for each update or return their part through a future. A WorkerLocal<T> instead gives each
+*	thread of the pool its own instance. A job updates the instance of the thread it runs on - no other thread
+*	touches it, so no lock and no atomic operation is needed. Once the jobs are finished, Combine or ForEach
+*	merges the instances.
+*
+*	The instances live in a CacheAlignedArray - each on its own cache lines, so the threads do not slow each
+*	other down by false sharing. The instance of the calling thread is found by its index in the pool
+*	(ThreadPool::GetWorkerIndex, inline) - a plain array access, no lookup in a map and no thread_local instance
+*	per WorkerLocal. A job with many updates takes the reference once with Local() and keeps it.
+*
+*	There is one more instance for the threads outside the pool, e.g. the thread which runs a part of a
+*	ParallelFor itself. It belongs to the first such thread which calls Local(), until the next Combine or
+*	ForEach. Local() throws std::logic_error for another thread outside the pool in the meantime - two of them
+*	would update the same instance at the same time.
+*
+*	The instances may be read only while no job uses them - Combine and ForEach are not synchronized with the
+*	jobs. Wait for the futures of the jobs (or for the end of the parallel loop) first.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_WORKER_LOCAL_H
+#define CTP_WORKER_LOCAL_H
+
+#include "cache_aligned_array.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace CTP
+{
+	template <typename T>
+	class WorkerLocal
+	{
+	public:
+		// one copy of value for each thread index of the pool plus one for the threads outside of it.
+		// The pool must outlive the WorkerLocal
+		explicit WorkerLocal(const ThreadPool& pool, const T& value = T())
+			: m_pool(pool)
+			, m_values(pool.GetWorkerSlotCount() + 1, value)
+			, m_outsideUser(std::thread::id())
+		{
+		}
+
+		WorkerLocal(const WorkerLocal&) = delete;
+		WorkerLocal& operator=(const WorkerLocal&) = delete;
+
+		// the instance of the calling thread. For a thread outside of the pool the last instance - see the file header
+		T& Local()
+		{
+			const size_t index = m_pool.GetWorkerIndex();
+			if (NO_WORKER != index)
+			{
+				return m_values[index];
+			}
+			ClaimOutsideInstance();
+			return m_values[m_values.Size() - 1];
+		}
+
+		// the instance of the given thread index - the last index is the one of the threads outside of the pool
+		T& operator[](size_t index)
+		{
+			return m_values[index];
+		}
+
+		const T& operator[](size_t index) const
+		{
+			return m_values[index];
+		}
+
+		// the number of instances - GetWorkerSlotCount() + 1
+		size_t Size() const
+		{
+			return m_values.Size();
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Calls body(instance) for each instance, in the order of the thread indexes.
+		//-----------------------------------------------------------------------------
+		template <typename F>
+		void ForEach(F&& body)
+		{
+			ReleaseOutsideInstance();
+			for (size_t i = 0; i < m_values.Size(); i++)
+			{
+				body(m_values[i]);
+			}
+		}
+
+		template <typename F>
+		void ForEach(F&& body) const
+		{
+			ReleaseOutsideInstance();
+			for (size_t i = 0; i < m_values.Size(); i++)
+			{
+				body(m_values[i]);
+			}
+		}
+
+		//-----------------------------------------------------------------------------
+		/// Merges all instances: init = reduce(init, instance) for each instance.
+		//
+		// The instances are merged in the order of the thread indexes. Which job ran on
+		// which thread differs from run to run - reduce should be associative and commutative.
+		//-----------------------------------------------------------------------------
+		template <typename R, typename Reduce>
+		R Combine(R init, Reduce reduce) const
+		{
+			ReleaseOutsideInstance();
+			for (size_t i = 0; i < m_values.Size(); i++)
+			{
+				init = reduce(std::move(init), m_values[i]);
+			}
+			return init;
+		}
+
+	private:
+		// makes the calling thread the user of the instance of the threads outside of the pool
+		void ClaimOutsideInstance() const
+		{
+			const std::thread::id self = std::this_thread::get_id();
+			std::thread::id user = m_outsideUser.load(std::memory_order_relaxed);
+			if (user == self)
+			{
+				return;
+			}
+			if (std::thread::id() == user && m_outsideUser.compare_exchange_strong(user, self))
+			{
+				return;
+			}
+			throw std::logic_error("WorkerLocal::Local - two threads outside of the pool use the same instance");
+		}
+
+		// the jobs are done once the instances are read - the next thread outside of the pool may claim its instance
+		void ReleaseOutsideInstance() const
+		{
+			m_outsideUser.store(std::thread::id());
+		}
+
+		const ThreadPool& m_pool;
+		CacheAlignedArray<T> m_values;
+
+		// the thread outside of the pool which uses the last instance - none by default
+		mutable std::atomic<std::thread::id> m_outsideUser;
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_WORKER_LOCAL_H
@@ -0,0 +1,160 @@
+/***********************************************************************************************************************
+* @file worker_thread.cpp
+*
+* @brief A thread of the pool with a configurable stack size and stack guard size - the implementation.
+*
+* @details	 See worker_thread.h.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+
+#include "worker_thread.h"
+#include "cpu_affinity.h"
+
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include <climits>
+#include <unistd.h>
+#endif
+
+namespace CTP
+{
+#if defined(__linux__)
+	// the entry point given to pthread_create - takes over the body allocated by Start
+	static void* RunThreadBody(void* argument)
+	{
+		std::unique_ptr<std::function<void()>> body(static_cast<std::function<void()>*>(argument));
+		(*body)();
+		return nullptr;
+	}
+
+	// at least PTHREAD_STACK_MIN and a multiple of the page size - other sizes may be refused
+	static size_t RoundStackSize(size_t stackSize)
+	{
+		const long pageSize = sysconf(_SC_PAGESIZE);
+		const size_t page = pageSize > 0 ? static_cast<size_t>(pageSize) : 4096;
+		const size_t minimum = static_cast<size_t>(PTHREAD_STACK_MIN);
+		const size_t size = stackSize < minimum ? minimum : stackSize;
+		return (size + page - 1) / page * page;
+	}
+#endif
+
+	WorkerThread::~WorkerThread()
+	{
+		if (IsJoinable())
+		{
+			Join();
+		}
+	}
+
+	/***********************************************************************************************************************
+	* @brief Starts the thread with the given stack and guard size.
+	*
+	* @details	The body is moved to the heap and handed to the new thread, which destroys it at its end. If the
+	*	thread cannot be created the body is released again and std::system_error is thrown - the same as for
+	*	std::thread.
+	*
+	* @pre The thread is not started yet, or it has been joined
+	* @post None
+	* @param[in]  std::function<void()> body - what the thread executes
+	* @param[in]  size_t stackSize - the stack size in bytes, 0 for the default of the system
+	* @param[in]  size_t guardSize - the size of the guard area below the stack in bytes, 0 for the default
+	* @return None
+	*
+	* @author Atanas Rusev and Ferai Ali
+	*
+	* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License file in the library.
+	*
+	***********************************************************************************************************************/
+	void WorkerThread::Start(std::function<void()> body, size_t stackSize, size_t guardSize)
+	{
+#if defined(__linux__)
+		pthread_attr_t attributes;
+		int result = pthread_attr_init(&attributes);
+		if (0 == result && stackSize > 0)
+		{
+			result = pthread_attr_setstacksize(&attributes, RoundStackSize(stackSize));
+		}
+		if (0 == result && guardSize > 0)
+		{
+			result = pthread_attr_setguardsize(&attributes, guardSize);
+		}
+
+		std::unique_ptr<std::function<void()>> argument(new std::function<void()>(std::move(body)));
+		if (0 == result)
+		{
+			result = pthread_create(&m_handle, &attributes, &RunThreadBody, argument.get());
+		}
+		pthread_attr_destroy(&attributes);
+
+		if (0 != result)
+		{
+			throw std::system_error(result, std::generic_category(), "WorkerThread::Start");
+		}
+		argument.release();
+		m_joinable = true;
+#else
+		(void)stackSize;
+		(void)guardSize;
+		m_thread = std::thread(std::move(body));
+#endif
+	}
+
+	bool WorkerThread::IsJoinable() const
+	{
+#if defined(__linux__)
+		return m_joinable;
+#else
+		return m_thread.joinable();
+#endif
+	}
+
+	void WorkerThread::Join()
+	{
+#if defined(__linux__)
+		pthread_join(m_handle, nullptr);
+		m_joinable = false;
+#else
+		m_thread.join();
+#endif
+	}
+
+	bool WorkerThread::Pin(const std::vector<int>& cpus)
+	{
+#if defined(__linux__)
+		return PinThread(m_handle, cpus);
+#else
+		return PinThread(m_thread, cpus);
+#endif
+	}
+
+	bool WorkerThread::GetStack(size_t& stackSize, size_t& guardSize) const
+	{
+#if defined(__linux__)
+		pthread_attr_t attributes;
+		if (!m_joinable || 0 != pthread_getattr_np(m_handle, &attributes))
+		{
+			return false;
+		}
+		const bool known = 0 == pthread_attr_getstacksize(&attributes, &stackSize)
+			&& 0 == pthread_attr_getguardsize(&attributes, &guardSize);
+		pthread_attr_destroy(&attributes);
+		return known;
+#else
+		(void)stackSize;
+		(void)guardSize;
+		return false;
+#endif
+	}
+
+} // end of namespace CTP
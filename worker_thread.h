@@ -0,0 +1,78 @@
+/***********************************************************************************************************************
+* @file worker_thread.h
+*
+* @brief A thread of the pool with a configurable stack size and stack guard size.
+*
+* @details	 std::thread takes no attributes - each thread gets the default stack of the system, on Linux usually
+*	8 MB of virtual memory plus a guard page. Most of it is never touched, but with many pools of many threads
+*	the mappings and the accounted virtual memory grow large, e.g. in containers with a memory limit.
+*
+*	WorkerThread creates the thread with pthread_create and sets the stack size and the guard size through the
+*	thread attributes. A size of 0 keeps the default of the system. The stack size is rounded up to the page size
+*	and to at least PTHREAD_STACK_MIN - GetStack reports what the thread really got.
+*
+*	On systems without pthreads a std::thread is used instead and the sizes are ignored.
+*
+*  The code is based completely on C++11 features. The purpose is to be able to integrate it
+*  in older projects which have not yet reached C++14 or higher. If you need newer features
+*  fork the code and get it to the next level yourself.
+*
+* @author Atanas Rusev and Ferai Ali
+*
+* @copyright 2019 Atanas Rusev and Ferai Ali, MIT License. Check the License.h file in the library.
+*
+***********************************************************************************************************************/
+#pragma once
+#ifndef CTP_WORKER_THREAD_H
+#define CTP_WORKER_THREAD_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace CTP
+{
+	class WorkerThread
+	{
+	public:
+		WorkerThread() = default;
+
+		// a thread which is still joinable is joined - unlike std::thread, which would call std::terminate
+		~WorkerThread();
+
+		WorkerThread(const WorkerThread&) = delete;
+		WorkerThread& operator=(const WorkerThread&) = delete;
+
+		//-----------------------------------------------------------------------------
+		/// Starts the thread executing body. Throws std::system_error if this fails.
+		//
+		// stackSize and guardSize in bytes - 0 for the default of the system.
+		//-----------------------------------------------------------------------------
+		void Start(std::function<void()> body, size_t stackSize, size_t guardSize);
+
+		bool IsJoinable() const;
+		void Join();
+
+		// lets the thread run only on the given CPUs - see cpu_affinity.h
+		bool Pin(const std::vector<int>& cpus);
+
+		// the stack size and the guard size of the started thread as the system reports them. False if unknown
+		bool GetStack(size_t& stackSize, size_t& guardSize) const;
+
+	private:
+#if defined(__linux__)
+		pthread_t m_handle = pthread_t();
+		bool m_joinable = false;
+#else
+		std::thread m_thread;
+#endif
+	};
+
+} // end of namespace CTP
+
+#endif // CTP_WORKER_THREAD_H